@@ -0,0 +1,204 @@
+// arrow_sink.hpp
+#pragma once
+#if defined(BLOCKHOUSE_WITH_ARROW)
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <parquet/arrow/writer.h>
+
+#include "mbo.hpp"
+#include "mbp_sink.hpp"
+
+// Columnar MBP output: rows are gathered into Arrow record batches and
+// written either as an Arrow IPC file or as Parquet. Prices stay int64
+// fixed-point at 1e-9 (null when undefined) so nothing is lost to
+// floating point. Build with -DBLOCKHOUSE_WITH_ARROW and link against
+// arrow and parquet.
+class ArrowSink : public MbpSink {
+    static constexpr int64_t BATCH_ROWS = 1 << 16;
+
+    size_t book_depth_;
+    std::shared_ptr<arrow::Schema> schema_;
+    std::shared_ptr<arrow::io::FileOutputStream> sink_;
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> ipc_;
+    std::unique_ptr<parquet::arrow::FileWriter> parquet_;
+    bool ok_ = true;
+    int64_t rows_ = 0;
+
+    arrow::TimestampBuilder ts_recv_{ arrow::timestamp(arrow::TimeUnit::NANO, "UTC"), arrow::default_memory_pool() };
+    arrow::TimestampBuilder ts_event_{ arrow::timestamp(arrow::TimeUnit::NANO, "UTC"), arrow::default_memory_pool() };
+    arrow::UInt8Builder rtype_;
+    arrow::UInt16Builder publisher_id_;
+    arrow::UInt32Builder instrument_id_;
+    arrow::StringBuilder action_;
+    arrow::StringBuilder side_;
+    arrow::Int32Builder depth_;
+    arrow::Int64Builder price_;
+    arrow::UInt32Builder size_;
+    arrow::UInt8Builder flags_;
+    arrow::Int32Builder ts_in_delta_;
+    arrow::UInt32Builder sequence_;
+    std::vector<arrow::Int64Builder> px_;
+    std::vector<arrow::UInt32Builder> sz_;
+    std::vector<arrow::UInt32Builder> ct_;
+    arrow::StringBuilder symbol_;
+    arrow::UInt64Builder order_id_;
+
+    void check(const arrow::Status& s) { ok_ = ok_ && s.ok(); }
+
+    std::string level_name(const char* field, size_t i) const {
+        const char* side = i < book_depth_ ? "bid" : "ask";
+        size_t n = i % book_depth_;
+        return std::string(side) + "_" + field + "_" + (n < 10 ? "0" : "") + std::to_string(n);
+    }
+
+    std::shared_ptr<arrow::Schema> make_schema() const {
+        auto ts = arrow::timestamp(arrow::TimeUnit::NANO, "UTC");
+        arrow::FieldVector fields = {
+            arrow::field("ts_recv", ts),
+            arrow::field("ts_event", ts),
+            arrow::field("rtype", arrow::uint8()),
+            arrow::field("publisher_id", arrow::uint16()),
+            arrow::field("instrument_id", arrow::uint32()),
+            arrow::field("action", arrow::utf8()),
+            arrow::field("side", arrow::utf8()),
+            arrow::field("depth", arrow::int32()),
+            arrow::field("price", arrow::int64()),
+            arrow::field("size", arrow::uint32()),
+            arrow::field("flags", arrow::uint8()),
+            arrow::field("ts_in_delta", arrow::int32()),
+            arrow::field("sequence", arrow::uint32()),
+        };
+        for (size_t i = 0; i < 2 * book_depth_; ++i) {
+            fields.push_back(arrow::field(level_name("px", i), arrow::int64()));
+            fields.push_back(arrow::field(level_name("sz", i), arrow::uint32()));
+            fields.push_back(arrow::field(level_name("ct", i), arrow::uint32()));
+        }
+        fields.push_back(arrow::field("symbol", arrow::utf8()));
+        fields.push_back(arrow::field("order_id", arrow::uint64()));
+        return arrow::schema(fields);
+    }
+
+    template <typename Builder>
+    void finish_into(Builder& b, arrow::ArrayVector& out) {
+        std::shared_ptr<arrow::Array> a;
+        check(b.Finish(&a));
+        out.push_back(a);
+    }
+
+    void flush_batch() {
+        if (rows_ == 0 || !ok_) {
+            return;
+        }
+        arrow::ArrayVector cols;
+        finish_into(ts_recv_, cols);
+        finish_into(ts_event_, cols);
+        finish_into(rtype_, cols);
+        finish_into(publisher_id_, cols);
+        finish_into(instrument_id_, cols);
+        finish_into(action_, cols);
+        finish_into(side_, cols);
+        finish_into(depth_, cols);
+        finish_into(price_, cols);
+        finish_into(size_, cols);
+        finish_into(flags_, cols);
+        finish_into(ts_in_delta_, cols);
+        finish_into(sequence_, cols);
+        for (size_t i = 0; i < 2 * book_depth_; ++i) {
+            finish_into(px_[i], cols);
+            finish_into(sz_[i], cols);
+            finish_into(ct_[i], cols);
+        }
+        finish_into(symbol_, cols);
+        finish_into(order_id_, cols);
+        if (!ok_) {
+            return;
+        }
+        auto batch = arrow::RecordBatch::Make(schema_, rows_, cols);
+        check(ipc_ ? ipc_->WriteRecordBatch(*batch) : parquet_->WriteRecordBatch(*batch));
+        rows_ = 0;
+    }
+
+    void append_price(arrow::Int64Builder& b, int64_t price) {
+        check(price == PRICE_UNDEF ? b.AppendNull() : b.Append(price));
+    }
+
+public:
+    ArrowSink(int fd, bool parquet, size_t depth)
+        : book_depth_(depth), schema_(make_schema()), px_(2 * depth), sz_(2 * depth), ct_(2 * depth) {
+        auto out = arrow::io::FileOutputStream::Open(fd);
+        if (!out.ok()) {
+            ok_ = false;
+            return;
+        }
+        sink_ = *out;
+        if (parquet) {
+            auto w = parquet::arrow::FileWriter::Open(*schema_, arrow::default_memory_pool(), sink_);
+            if (w.ok()) {
+                parquet_ = std::move(*w);
+            }
+            ok_ = w.ok();
+        } else {
+            auto w = arrow::ipc::MakeFileWriter(sink_, schema_);
+            if (w.ok()) {
+                ipc_ = *w;
+            }
+            ok_ = w.ok();
+        }
+    }
+
+    void write_row(uint32_t, const MboMessage& m, LevelsView levels) override {
+        if (!ok_) {
+            return;
+        }
+        check(ts_recv_.Append(static_cast<int64_t>(m.ts_recv)));
+        check(ts_event_.Append(static_cast<int64_t>(m.ts_event)));
+        check(rtype_.Append(static_cast<uint8_t>(levels.depth)));
+        check(publisher_id_.Append(m.publisher_id));
+        check(instrument_id_.Append(m.instrument_id));
+        char action = static_cast<char>(m.action);
+        char side = static_cast<char>(m.side);
+        check(action_.Append(&action, 1));
+        check(side_.Append(&side, 1));
+        check(depth_.Append(m.depth));
+        append_price(price_, m.price);
+        check(size_.Append(m.size));
+        check(flags_.Append(m.flags));
+        check(ts_in_delta_.Append(m.ts_in_delta));
+        check(sequence_.Append(m.sequence));
+        for (size_t i = 0; i < 2 * book_depth_; ++i) {
+            append_price(px_[i], levels[i].price);
+            check(sz_[i].Append(levels[i].size));
+            check(ct_[i].Append(levels[i].count));
+        }
+        auto sym = m.symbol.view();
+        check(symbol_.Append(sym.data(), static_cast<int32_t>(sym.size())));
+        check(order_id_.Append(m.order_id));
+        if (++rows_ == BATCH_ROWS) {
+            flush_batch();
+        }
+    }
+
+    bool finish() override {
+        flush_batch();
+        if (ipc_) {
+            check(ipc_->Close());
+            ipc_.reset();
+        }
+        if (parquet_) {
+            check(parquet_->Close());
+            parquet_.reset();
+        }
+        if (sink_) {
+            check(sink_->Close());
+            sink_.reset();
+        }
+        return ok_;
+    }
+};
+#endif
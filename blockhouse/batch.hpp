@@ -0,0 +1,263 @@
+// batch.hpp
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "book_manager.hpp"
+#include "dbn_reader.hpp"
+#include "input_source.hpp"
+#include "instrument.hpp"
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+#include "thread_pool.hpp"
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+    uint64_t size = 0;
+};
+
+namespace batch_detail {
+
+// '*' matches any run of characters, '?' any one.
+inline bool glob_match(std::string_view pat, std::string_view name) {
+    size_t p = 0, n = 0, star = std::string_view::npos, mark = 0;
+    while (n < name.size()) {
+        if (p < pat.size() && (pat[p] == '?' || pat[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (p < pat.size() && pat[p] == '*') {
+            star = p++;
+            mark = n;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            n = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (p < pat.size() && pat[p] == '*') {
+        ++p;
+    }
+    return p == pat.size();
+}
+
+// <dir>/<input file name less .csv, .dbn or .dbn.zst>.mbp.csv
+inline std::string output_path(const std::string& dir, const std::string& input) {
+    std::string name = std::filesystem::path(input).filename().string();
+    for (std::string_view ext : { ".dbn.zst", ".dbn", ".csv" }) {
+        if (name.size() > ext.size() && std::string_view(name).substr(name.size() - ext.size()) == ext) {
+            name.resize(name.size() - ext.size());
+            break;
+        }
+    }
+    return (std::filesystem::path(dir) / (name + ".mbp.csv")).string();
+}
+
+} // namespace batch_detail
+
+// Jobs from a glob over one directory (the pattern may only wildcard the
+// file name), or else from a manifest with one input per line, optionally
+// followed by its output path; blank lines and lines starting with # are
+// skipped. Outputs not named go to output_dir. False if nothing matched or
+// the manifest cannot be read.
+inline bool list_batch_jobs(const std::string& spec, const std::string& output_dir, std::vector<BatchJob>& jobs) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (spec.find_first_of("*?") != std::string::npos) {
+        fs::path pattern(spec);
+        fs::path dir = pattern.has_parent_path() ? pattern.parent_path() : fs::path(".");
+        std::string name = pattern.filename().string();
+        for (const auto& f : fs::directory_iterator(dir, ec)) {
+            if (f.is_regular_file(ec) && batch_detail::glob_match(name, f.path().filename().string())) {
+                jobs.push_back({ f.path().string(), {}, 0 });
+            }
+        }
+        std::sort(jobs.begin(), jobs.end(), [](const auto& a, const auto& b) { return a.input < b.input; });
+    } else {
+        std::ifstream manifest(spec);
+        if (!manifest) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(manifest, line)) {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#') {
+                continue;
+            }
+            size_t e = line.find_first_of(" \t\r", b);
+            BatchJob job{ line.substr(b, e - b), {}, 0 };
+            if (e != std::string::npos) {
+                size_t ob = line.find_first_not_of(" \t\r", e);
+                if (ob != std::string::npos) {
+                    job.output = line.substr(ob, line.find_first_of(" \t\r", ob) - ob);
+                }
+            }
+            jobs.push_back(std::move(job));
+        }
+    }
+    for (auto& job : jobs) {
+        if (job.output.empty()) {
+            job.output = batch_detail::output_path(output_dir, job.input);
+        }
+        job.size = fs::file_size(job.input, ec);
+        if (ec) {
+            job.size = 0;
+        }
+    }
+    return !jobs.empty();
+}
+
+// Reconstructs independent files to CSV on a work-stealing pool, biggest
+// first so the long ones do not trail at the end. Each worker keeps its
+// books, input buffer and output buffer across jobs, so a warmed-up worker
+// stops allocating. Jobs read their whole input and write their whole
+// output while holding one of a fixed number of I/O slots, so adding
+// threads adds compute without piling more streams onto the disk.
+template <size_t Depth = BOOK_DEPTH>
+class BatchReconstruction {
+    static constexpr size_t READ_BLOCK = 1 << 20;
+
+    struct Worker {
+        BookManager<Depth> books;
+        std::vector<char> input;
+        OutputBuffer out{ OutputBuffer::IN_MEMORY };
+        // Level text caches stay valid across jobs: they key on values.
+        MbpWriterSet writers;
+
+        Worker(size_t orders, const PricePrecision* prices) : books(orders), writers(out, prices) {}
+    };
+
+    std::vector<BatchJob> jobs_;
+    bool changed_only_;
+    WorkStealingPool pool_;
+    IoSlots io_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> failed_{ 0 };
+    std::atomic<uint64_t> messages_{ 0 };
+    std::atomic<uint64_t> bytes_out_{ 0 };
+
+    bool read_file(const std::string& path, std::vector<char>& buf, size_t& len) {
+        std::lock_guard<IoSlots> slot(io_);
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) {
+            return false;
+        }
+        len = 0;
+        while (true) {
+            if (buf.size() - len < READ_BLOCK) {
+                buf.resize(len + READ_BLOCK);
+            }
+            size_t n = std::fread(buf.data() + len, 1, buf.size() - len, f);
+            if (n == 0) {
+                break;
+            }
+            len += n;
+        }
+        bool ok = !std::ferror(f);
+        std::fclose(f);
+        return ok;
+    }
+
+    bool write_file(const std::string& path, std::string_view data) {
+        std::lock_guard<IoSlots> slot(io_);
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) {
+            return false;
+        }
+        bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+        instrument::count_bytes(data.size());
+        return std::fclose(f) == 0 && ok;
+    }
+
+    bool reconstruct(Worker& w, const BatchJob& job) {
+        size_t len = 0;
+        if (!read_file(job.input, w.input, len)) {
+            return false;
+        }
+        std::string_view data(w.input.data(), len);
+        w.books.reset();
+        w.out.clear();
+        uint64_t messages = 0;
+        auto emit = [&](const auto& e, const MboMessage& m) {
+            if (!changed_only_ || e.book.changes().any()) {
+                instrument::Timer timer(instrument::WRITE);
+                w.writers[e.id].write_row(m, e.book.levels());
+            }
+        };
+        if (is_dbn_path(job.input)) {
+            auto dbn = DbnReader::open(data);
+            if (!dbn) {
+                return false;
+            }
+            dbn->for_each([&](const MboMessage& m) {
+                w.books.process(m, emit);
+                ++messages;
+            });
+            if (dbn->failed()) {
+                return false;
+            }
+        } else {
+            for_each_line(data, [&](std::string_view line) {
+                std::optional<MboMessage> m;
+                {
+                    instrument::Timer timer(instrument::PARSE);
+                    m = MboMessage::parse(line);
+                }
+                if (m) {
+                    w.books.process(*m, emit);
+                    ++messages;
+                }
+            });
+        }
+        w.books.finish(emit);
+        messages_ += messages;
+        bytes_out_ += w.out.contents().size();
+        return write_file(job.output, w.out.contents());
+    }
+
+public:
+    BatchReconstruction(std::vector<BatchJob> jobs, size_t threads, size_t io_slots, size_t first_book_orders,
+                        bool changed_only = false, const PricePrecision* prices = nullptr)
+        : jobs_(std::move(jobs)), changed_only_(changed_only), pool_(threads), io_(io_slots) {
+        std::stable_sort(jobs_.begin(), jobs_.end(), [](const auto& a, const auto& b) { return a.size > b.size; });
+        for (size_t i = 0; i < pool_.workers(); ++i) {
+            workers_.push_back(std::make_unique<Worker>(first_book_orders, prices));
+        }
+    }
+
+    // Runs every job; false if any failed (each is named on stderr).
+    bool run() {
+        pool_.run(jobs_.size(), [this](size_t worker, size_t job) {
+            if (!reconstruct(*workers_[worker], jobs_[job])) {
+                std::fprintf(stderr, "cannot reconstruct %s into %s\n", jobs_[job].input.c_str(),
+                             jobs_[job].output.c_str());
+                ++failed_;
+            }
+        });
+        return failed_ == 0;
+    }
+
+    size_t jobs() const { return jobs_.size(); }
+    size_t failed() const { return failed_; }
+    uint64_t messages() const { return messages_; }
+    uint64_t bytes_out() const { return bytes_out_; }
+
+    uint64_t bytes_in() const {
+        uint64_t n = 0;
+        for (const auto& j : jobs_) {
+            n += j.size;
+        }
+        return n;
+    }
+};
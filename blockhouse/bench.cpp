@@ -0,0 +1,400 @@
+// bench.cpp
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "book_manager.hpp"
+#include "book_snapshot.hpp"
+#include "csv_scan.hpp"
+#include "input_source.hpp"
+#include "mbo.hpp"
+#include "mbp_sink.hpp"
+#include "mbp_writer.hpp"
+#include "order_book.hpp"
+#include "synthetic.hpp"
+
+// Each stage on its own, then the whole CSV path. Inputs come from
+// SyntheticMbo, so runs are repeatable.
+
+static constexpr size_t STREAM_LEN = 1 << 18;
+static constexpr uint32_t ORDERS_PER_LEVEL = 64;
+static constexpr size_t FILE_MESSAGES = 1 << 20;
+
+static int null_fd() {
+#if defined(_WIN32)
+    static int fd = ::_open("NUL", _O_WRONLY);
+#else
+    static int fd = ::open("/dev/null", O_WRONLY);
+#endif
+    return fd;
+}
+
+static const std::vector<MboMessage>& stream() {
+    static const std::vector<MboMessage> msgs = [] {
+        std::vector<MboMessage> v;
+        SyntheticMbo gen;
+        for (size_t i = 0; i < STREAM_LEN; ++i) {
+            v.push_back(gen.next());
+        }
+        return v;
+    }();
+    return msgs;
+}
+
+static const std::string& stream_csv() {
+    static const std::string text = [] {
+        std::string s;
+        char line[MAX_MBO_CSV_LEN];
+        for (const auto& m : stream()) {
+            s.append(line, format_mbo_csv(line, m));
+        }
+        return s;
+    }();
+    return text;
+}
+
+static MboMessage make_msg(Action action, Side side, int64_t price, uint32_t size, uint64_t order_id) {
+    MboMessage m;
+    m.action = action;
+    m.side = side;
+    m.price = price;
+    m.size = size;
+    m.order_id = order_id;
+    return m;
+}
+
+static int64_t level_price(Side side, uint32_t level) {
+    SyntheticConfig cfg;
+    int64_t off = static_cast<int64_t>(level) * cfg.tick;
+    return side == Side::B ? cfg.mid - cfg.tick - off : cfg.mid + off;
+}
+
+// levels price levels per side, ORDERS_PER_LEVEL orders each, ids from 1.
+static void prefill(OrderBook<>& book, uint32_t levels) {
+    uint64_t id = 1;
+    book.reserve(2 * levels * ORDERS_PER_LEVEL + STREAM_LEN);
+    for (uint32_t l = 0; l < levels; ++l) {
+        for (uint32_t k = 0; k < ORDERS_PER_LEVEL; ++k) {
+            book.apply(make_msg(Action::A, Side::B, level_price(Side::B, l), 100, id++));
+            book.apply(make_msg(Action::A, Side::A, level_price(Side::A, l), 100, id++));
+        }
+    }
+}
+
+static void BM_Parse(benchmark::State& state) {
+    const std::string& text = stream_csv();
+    std::vector<std::string_view> lines;
+    for (size_t p = 0; p < text.size();) {
+        size_t nl = text.find('\n', p);
+        lines.emplace_back(text.data() + p, nl - p);
+        p = nl + 1;
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MboMessage::parse(lines[i]));
+        i = i + 1 == lines.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size() / lines.size()));
+}
+BENCHMARK(BM_Parse);
+
+// Locating a line's fields, once per scan kernel this CPU can run.
+static void BM_FindCommas(benchmark::State& state) {
+    const std::string& text = stream_csv();
+    csv_scan::Kernel k = csv_scan::kernels()[static_cast<size_t>(state.range(0))];
+    state.SetLabel(k.name);
+    uint32_t commas[MboMessage::FIELDS];
+    size_t p = 0;
+    for (auto _ : state) {
+        size_t nl = text.find('\n', p);
+        benchmark::DoNotOptimize(k.find(text.data() + p, nl - p, ',', commas, MboMessage::FIELDS));
+        p = nl + 1 == text.size() ? 0 : nl + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FindCommas)->DenseRange(0, static_cast<int64_t>(csv_scan::kernels().size()) - 1);
+
+// New orders at random occupied levels; the book is rebuilt every
+// STREAM_LEN adds.
+static void BM_ApplyAdd(benchmark::State& state) {
+    uint32_t levels = static_cast<uint32_t>(state.range(0));
+    SplitMix64 rng(1);
+    std::vector<MboMessage> adds;
+    uint64_t id = 2ull * levels * ORDERS_PER_LEVEL + 1;
+    for (size_t i = 0; i < STREAM_LEN; ++i) {
+        Side side = rng.below(2) ? Side::B : Side::A;
+        adds.push_back(make_msg(Action::A, side, level_price(side, static_cast<uint32_t>(rng.below(levels))), 100, id++));
+    }
+    auto book = std::make_unique<OrderBook<>>();
+    prefill(*book, levels);
+    size_t i = 0;
+    for (auto _ : state) {
+        book->apply(adds[i]);
+        if (++i == adds.size()) {
+            state.PauseTiming();
+            book = std::make_unique<OrderBook<>>();
+            prefill(*book, levels);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ApplyAdd)->Arg(8)->Arg(64)->Arg(512);
+
+// Full cancels of resting orders in random order, down to an empty book.
+static void BM_ApplyCancel(benchmark::State& state) {
+    uint32_t levels = static_cast<uint32_t>(state.range(0));
+    uint32_t n = 2 * levels * ORDERS_PER_LEVEL;
+    std::vector<MboMessage> cancels;
+    for (uint64_t id = 1; id <= n; ++id) {
+        Side side = id % 2 ? Side::B : Side::A;
+        cancels.push_back(make_msg(Action::C, side, 0, 100, id));
+    }
+    SplitMix64 rng(2);
+    for (size_t i = cancels.size(); i > 1; --i) {
+        std::swap(cancels[i - 1], cancels[rng.below(i)]);
+    }
+    auto book = std::make_unique<OrderBook<>>();
+    prefill(*book, levels);
+    size_t i = 0;
+    for (auto _ : state) {
+        book->apply(cancels[i]);
+        if (++i == cancels.size()) {
+            state.PauseTiming();
+            book = std::make_unique<OrderBook<>>();
+            prefill(*book, levels);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ApplyCancel)->Arg(8)->Arg(64)->Arg(512);
+
+// Resting orders moved to another occupied level, or modified at their own
+// price.
+static void BM_ApplyModify(benchmark::State& state) {
+    uint32_t levels = static_cast<uint32_t>(state.range(0));
+    bool move = state.range(1) != 0;
+    uint32_t n = 2 * levels * ORDERS_PER_LEVEL;
+    SplitMix64 rng(3);
+    std::vector<MboMessage> mods;
+    for (size_t i = 0; i < STREAM_LEN; ++i) {
+        uint64_t id = 1 + rng.below(n);
+        Side side = id % 2 ? Side::B : Side::A;
+        uint32_t l = move ? static_cast<uint32_t>(rng.below(levels)) : 0;
+        mods.push_back(make_msg(Action::M, side, move ? level_price(side, l) : 0, 1 + static_cast<uint32_t>(rng.below(100)), id));
+    }
+    OrderBook<> book;
+    prefill(book, levels);
+    if (!move) {
+        // Keep each order at its own price so modifies only resize.
+        for (auto& m : mods) {
+            uint32_t l = static_cast<uint32_t>((m.order_id - 1) / 2 / ORDERS_PER_LEVEL);
+            m.price = level_price(m.side, l);
+        }
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        book.apply(mods[i]);
+        i = i + 1 == mods.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ApplyModify)->ArgsProduct({ { 8, 64, 512 }, { 0, 1 } });
+
+// The synthetic mix through BookManager, per visible depth.
+template <size_t Depth>
+static void BM_ApplyMixed(benchmark::State& state) {
+    const auto& msgs = stream();
+    auto books = std::make_unique<BookManager<Depth>>(STREAM_LEN);
+    auto emit = [](const auto& e, const MboMessage&) { benchmark::DoNotOptimize(&e); };
+    size_t i = 0;
+    for (auto _ : state) {
+        books->process(msgs[i], emit);
+        if (++i == msgs.size()) {
+            state.PauseTiming();
+            books = std::make_unique<BookManager<Depth>>(STREAM_LEN);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ApplyMixed, 1);
+BENCHMARK_TEMPLATE(BM_ApplyMixed, 10);
+BENCHMARK_TEMPLATE(BM_ApplyMixed, 50);
+
+// Copying the visible levels out of a populated book.
+template <size_t Depth>
+static void BM_Snapshot(benchmark::State& state) {
+    OrderBook<Depth> book;
+    for (const auto& m : stream()) {
+        book.apply(m);
+    }
+    for (auto _ : state) {
+        std::array<PriceLevel, 2 * Depth> copy = book.snapshot();
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK_TEMPLATE(BM_Snapshot, 1);
+BENCHMARK_TEMPLATE(BM_Snapshot, 10);
+BENCHMARK_TEMPLATE(BM_Snapshot, 50);
+
+// The mixed stream with every visible change published to a board.
+static void BM_ApplyPublished(benchmark::State& state) {
+    const auto& msgs = stream();
+    SnapshotBoard<> board;
+    auto books = std::make_unique<BookManager<>>(STREAM_LEN);
+    books->publish_to(&board);
+    auto emit = [](const auto& e, const MboMessage&) { benchmark::DoNotOptimize(&e); };
+    size_t i = 0;
+    for (auto _ : state) {
+        books->process(msgs[i], emit);
+        if (++i == msgs.size()) {
+            state.PauseTiming();
+            books = std::make_unique<BookManager<>>(STREAM_LEN);
+            books->publish_to(&board);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ApplyPublished);
+
+// A reader polling one published book, with no writer running.
+template <size_t Depth>
+static void BM_SnapshotRead(benchmark::State& state) {
+    SnapshotBoard<Depth> board(1);
+    OrderBook<Depth> book;
+    for (const auto& m : stream()) {
+        book.apply(m);
+    }
+    board.publish(0, book, stream().back());
+    const auto& slot = board.slot(0);
+    for (auto _ : state) {
+        BookSnapshot<Depth> snap;
+        benchmark::DoNotOptimize(slot.try_load(snap));
+        benchmark::DoNotOptimize(snap);
+    }
+}
+BENCHMARK_TEMPLATE(BM_SnapshotRead, 1);
+BENCHMARK_TEMPLATE(BM_SnapshotRead, 10);
+
+// Queue position of random resting orders, ORDERS_PER_LEVEL per level.
+static void BM_QueuePosition(benchmark::State& state) {
+    uint32_t levels = static_cast<uint32_t>(state.range(0));
+    OrderBook<> book;
+    prefill(book, levels);
+    SplitMix64 rng(1);
+    std::vector<uint64_t> ids;
+    for (size_t i = 0; i < STREAM_LEN; ++i) {
+        ids.push_back(rng.below(2ull * levels * ORDERS_PER_LEVEL) + 1);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(book.queue_position(ids[i]));
+        i = i + 1 == ids.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueuePosition)->Arg(8)->Arg(512);
+
+// Bid depth within a random number of ticks of the touch, by walking the
+// levels (0) or from the ladder (1).
+static void BM_DepthWithin(benchmark::State& state) {
+    uint32_t levels = static_cast<uint32_t>(state.range(0));
+    SyntheticConfig cfg;
+    OrderBook<> book;
+    if (state.range(1)) {
+        book.index_depth(cfg.tick, 4096);
+    }
+    prefill(book, levels);
+    SplitMix64 rng(1);
+    std::vector<int64_t> distances;
+    for (size_t i = 0; i < STREAM_LEN; ++i) {
+        distances.push_back(static_cast<int64_t>(rng.below(levels)) * cfg.tick);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(book.depth_within(Side::B, distances[i]));
+        i = i + 1 == distances.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DepthWithin)->ArgsProduct({ { 8, 512 }, { 0, 1 } });
+
+// CSV rows for the synthetic stream, written to the null device.
+static void BM_FormatRow(benchmark::State& state) {
+    const auto& msgs = stream();
+    std::vector<std::array<PriceLevel, 2 * BOOK_DEPTH>> snaps;
+    OrderBook<> book;
+    for (const auto& m : msgs) {
+        book.apply(m);
+        snaps.push_back(book.snapshot());
+    }
+    OutputBuffer out(null_fd());
+    MbpWriter writer(out);
+    size_t i = 0;
+    for (auto _ : state) {
+        writer.write_row(msgs[i], LevelsView{ snaps[i].data(), BOOK_DEPTH });
+        i = i + 1 == msgs.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FormatRow);
+
+// Whole CSV path over a generated file: read, parse, apply, format.
+static void BM_EndToEnd(benchmark::State& state) {
+    static const std::string path = [] {
+        std::string p = (std::filesystem::temp_directory_path() / "blockhouse_bench.csv").string();
+        std::FILE* f = std::fopen(p.c_str(), "wb");
+        if (!f) {
+            return std::string();
+        }
+        SyntheticMbo gen;
+        char line[MAX_MBO_CSV_LEN];
+        std::fwrite(MBO_CSV_HEADER.data(), 1, MBO_CSV_HEADER.size(), f);
+        for (size_t i = 0; i < FILE_MESSAGES; ++i) {
+            std::fwrite(line, 1, static_cast<size_t>(format_mbo_csv(line, gen.next()) - line), f);
+        }
+        std::fclose(f);
+        return p;
+    }();
+    if (path.empty()) {
+        state.SkipWithError("cannot write input file");
+        return;
+    }
+    int64_t bytes = static_cast<int64_t>(std::filesystem::file_size(path));
+    for (auto _ : state) {
+        auto in = open_input(path.c_str());
+        BookManager<> books(FILE_MESSAGES / 8);
+        CsvSink sink(null_fd());
+        auto emit = [&](const auto& e, const MboMessage& m) { sink.write_row(e.id, m, e.book.levels()); };
+        for_each_line(*in, [&](std::string_view line) {
+            if (auto m = MboMessage::parse(line)) {
+                books.process(*m, emit);
+            }
+        });
+        books.finish(emit);
+        sink.finish();
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(FILE_MESSAGES));
+}
+BENCHMARK(BM_EndToEnd)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
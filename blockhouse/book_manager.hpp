@@ -0,0 +1,328 @@
+// book_manager.hpp
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "book_snapshot.hpp"
+#include "feed_stats.hpp"
+#include "instrument.hpp"
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+#include "order_book.hpp"
+#include "order_index.hpp"
+#include "spsc_ring.hpp"
+
+// Running totals of a book's trades (T messages).
+struct TradeStats {
+    uint64_t trades = 0;
+    uint64_t volume = 0;
+    // Sum of price * size, in price units.
+    double notional = 0;
+
+    void add(const MboMessage& m) {
+        if (m.price == PRICE_UNDEF) {
+            return;
+        }
+        ++trades;
+        volume += m.size;
+        notional += static_cast<double>(m.price) / PRICE_SCALE * m.size;
+    }
+
+    double vwap() const { return volume ? notional / static_cast<double>(volume) : 0; }
+};
+
+// Routes each message to the book for its (publisher_id, instrument_id).
+// Books are numbered in order of first appearance so callers can keep
+// per-book state, such as an MbpWriter, in a flat array.
+//
+// process() also folds the trade -> fill -> cancel sequence a match
+// produces into one row: the trade, reported on the resting order's side,
+// with the book as the cancel left it. A sequence that breaks off early
+// still yields its trade and fill rows, unmerged.
+template <size_t Depth = BOOK_DEPTH>
+class BookManager {
+public:
+    struct Entry {
+        OrderBook<Depth> book;
+        uint32_t id;
+        uint64_t key;
+        TradeStats trades;
+        SequenceStats sequence;
+    };
+
+private:
+    enum class Pending : uint8_t { None, Trade, Fill };
+
+    size_t first_reserve_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    // Books emptied by reset(), handed out again before allocating.
+    std::vector<std::unique_ptr<Entry>> spare_;
+    OrderIndex<Entry> index_;
+    // Most feeds run long stretches on one instrument.
+    uint64_t last_key_ = ~0ull;
+    Entry* last_ = nullptr;
+    Pending pending_ = Pending::None;
+    Entry* pending_entry_ = nullptr;
+    MboMessage trade_;
+    MboMessage fill_;
+    SnapshotBoard<Depth>* board_ = nullptr;
+
+    Entry& entry_for(const MboMessage& m) { return entry(key_of(m)); }
+
+    void apply(Entry& e, const MboMessage& m) {
+        e.book.apply(m);
+        if (board_ && e.book.changes().any()) {
+            board_->publish(e.id, e.book, m);
+        }
+    }
+
+public:
+    // The first book is sized for first_book_orders resting orders; later
+    // books start small and grow, since most inputs carry one instrument.
+    explicit BookManager(size_t first_book_orders = 0) : first_reserve_(first_book_orders) {}
+
+    static uint64_t key_of(const MboMessage& m) {
+        return (static_cast<uint64_t>(m.publisher_id) << 32) | m.instrument_id;
+    }
+
+    // The book for key, created empty on first use.
+    Entry& entry(uint64_t key) {
+        if (key == last_key_) {
+            return *last_;
+        }
+        Entry* e = index_.find(key);
+        if (!e) {
+            uint32_t id = static_cast<uint32_t>(entries_.size());
+            if (!spare_.empty()) {
+                entries_.push_back(std::move(spare_.back()));
+                spare_.pop_back();
+                entries_.back()->id = id;
+                entries_.back()->key = key;
+            } else {
+                entries_.push_back(std::make_unique<Entry>(Entry{ {}, id, key, {}, {} }));
+                if (id == 0) {
+                    entries_.back()->book.reserve(first_reserve_);
+                }
+            }
+            e = entries_.back().get();
+            index_.insert(key, e);
+        }
+        last_key_ = key;
+        last_ = e;
+        return *e;
+    }
+
+    // From here on, each book's visible levels go to board whenever a
+    // message changes them, for other threads to read while this one
+    // keeps applying. Slots are patched with just the changed levels, so
+    // a board must see every change from its books' creation: attach it
+    // before the first message and do not reuse it across reset().
+    void publish_to(SnapshotBoard<Depth>* board) { board_ = board; }
+
+    const Entry& apply(const MboMessage& m) {
+        Entry& e = entry_for(m);
+        e.sequence.add(m.sequence);
+        apply(e, m);
+        return e;
+    }
+
+    // Applies m and passes emit(entry, row) each output row it yields:
+    // usually one, none while a trade waits for its fill and cancel, and
+    // up to three when such a sequence breaks off. The book's changes()
+    // describe each row.
+    template <typename Emit>
+    void process(const MboMessage& m, Emit&& emit) {
+        Entry& e = entry_for(m);
+        e.sequence.add(m.sequence);
+        if (pending_ != Pending::None) {
+            if (&e == pending_entry_) {
+                if (pending_ == Pending::Trade && m.action == Action::F) {
+                    fill_ = m;
+                    pending_ = Pending::Fill;
+                    return;
+                }
+                if (pending_ == Pending::Fill && m.action == Action::C && m.order_id == fill_.order_id) {
+                    apply(e, m);
+                    trade_.side = m.side;
+                    pending_ = Pending::None;
+                    emit(e, trade_);
+                    return;
+                }
+            }
+            finish(emit);
+        }
+        apply(e, m);
+        if (m.action == Action::T) {
+            e.trades.add(m);
+            trade_ = m;
+            pending_entry_ = &e;
+            pending_ = Pending::Trade;
+            return;
+        }
+        emit(e, m);
+    }
+
+    // Emits a trade still waiting for its fill and cancel.
+    template <typename Emit>
+    void finish(Emit&& emit) {
+        if (pending_ == Pending::None) {
+            return;
+        }
+        const Entry& e = *pending_entry_;
+        emit(e, trade_);
+        if (pending_ == Pending::Fill) {
+            emit(e, fill_);
+        }
+        pending_ = Pending::None;
+    }
+
+    // Forgets every book and any pending trade for a new input. The books'
+    // storage is kept and reused, most recently used first.
+    void reset() {
+        while (!entries_.empty()) {
+            entries_.back()->book.reset();
+            entries_.back()->trades = {};
+            entries_.back()->sequence = {};
+            spare_.push_back(std::move(entries_.back()));
+            entries_.pop_back();
+        }
+        index_.clear();
+        last_key_ = ~0ull;
+        last_ = nullptr;
+        pending_ = Pending::None;
+    }
+
+    // True when no trade is held back waiting for its fill and cancel.
+    bool idle() const { return pending_ == Pending::None; }
+
+    size_t books() const { return entries_.size(); }
+
+    template <typename F>
+    void for_each_book(F&& fn) const {
+        for (const auto& e : entries_) {
+            fn(*e);
+        }
+    }
+};
+
+// Shards instruments across worker threads. The calling thread batches
+// messages per shard and hands them over through SPSC rings; each worker
+// owns its books and output buffer. Rows for one instrument stay in
+// order, but rows of instruments on different shards interleave at
+// output-buffer granularity.
+template <size_t Depth = BOOK_DEPTH>
+class ShardedBookManager {
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr size_t BATCHES_PER_SHARD = 8;
+
+    struct Batch {
+        size_t n = 0;
+        MboMessage msgs[BATCH_SIZE];
+    };
+
+    struct Shard {
+        OutputBuffer out;
+        BookManager<Depth> books;
+        MbpWriterSet writers;
+        std::unique_ptr<Batch[]> batches = std::make_unique<Batch[]>(BATCHES_PER_SHARD);
+        SpscRing<Batch*, BATCHES_PER_SHARD> full;
+        SpscRing<Batch*, BATCHES_PER_SHARD> empty;
+        Batch* cur = nullptr;
+        bool changed_only;
+        bool ok = true;
+        std::thread worker;
+
+        Shard(int fd, std::mutex& fd_lock, size_t first_book_orders, bool only_changed, const PricePrecision* prices)
+            : out(fd, fd_lock), books(first_book_orders), writers(out, prices), changed_only(only_changed) {
+            for (size_t i = 0; i < BATCHES_PER_SHARD; ++i) {
+                empty.push(&batches[i]);
+            }
+            worker = std::thread([this] { run(); });
+        }
+
+        void run() {
+            auto emit = [this](const auto& e, const MboMessage& m) {
+                if (!changed_only || e.book.changes().any()) {
+                    instrument::Timer timer(instrument::WRITE);
+                    writers[e.id].write_row(m, e.book.levels());
+                }
+            };
+            while (Batch* b = full.pop()) {
+                for (size_t i = 0; i < b->n; ++i) {
+                    books.process(b->msgs[i], emit);
+                }
+                b->n = 0;
+                empty.push(b);
+            }
+            books.finish(emit);
+            ok = out.flush();
+        }
+    };
+
+    std::mutex fd_lock_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    bool finished_ = false;
+
+    Shard& shard_for(const MboMessage& m) {
+        uint64_t h = BookManager<Depth>::key_of(m) * 0x9E3779B97F4A7C15ull;
+        return *shards_[(h >> 32) % shards_.size()];
+    }
+
+public:
+    // With changed_only, rows whose visible levels did not change are
+    // dropped.
+    ShardedBookManager(size_t shards, size_t first_book_orders, bool changed_only = false, int fd = 1,
+                       const PricePrecision* prices = nullptr) {
+        for (size_t i = 0; i < shards; ++i) {
+            shards_.push_back(std::make_unique<Shard>(fd, fd_lock_, first_book_orders / shards, changed_only, prices));
+        }
+    }
+
+    ~ShardedBookManager() { finish(); }
+
+    ShardedBookManager(const ShardedBookManager&) = delete;
+    ShardedBookManager& operator=(const ShardedBookManager&) = delete;
+
+    void process(const MboMessage& m) {
+        Shard& s = shard_for(m);
+        if (!s.cur) {
+            s.cur = s.empty.pop();
+        }
+        s.cur->msgs[s.cur->n++] = m;
+        if (s.cur->n == BATCH_SIZE) {
+            s.full.push(s.cur);
+            s.cur = nullptr;
+        }
+    }
+
+    template <typename F>
+    void for_each_book(F&& fn) const {
+        for (const auto& s : shards_) {
+            s->books.for_each_book(fn);
+        }
+    }
+
+    // Drains every shard and joins the workers; false if any write failed.
+    bool finish() {
+        if (finished_) {
+            return true;
+        }
+        finished_ = true;
+        for (auto& s : shards_) {
+            if (s->cur) {
+                s->full.push(s->cur);
+                s->cur = nullptr;
+            }
+            s->full.push(nullptr);
+        }
+        bool ok = true;
+        for (auto& s : shards_) {
+            s->worker.join();
+            ok = ok && s->ok;
+        }
+        return ok;
+    }
+};
@@ -0,0 +1,199 @@
+// book_snapshot.hpp
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "mbo.hpp"
+#include "order_book.hpp"
+
+// One writer, any number of readers, no locks. The writer bumps the
+// sequence to odd, stores the value, and bumps it to even again; a reader
+// copies the value between two loads of the sequence and keeps the copy
+// only if both match and are even. The writer never waits for readers,
+// and a reader only retries when a store overlapped its copy. The value
+// is held as relaxed atomic words, so the overlapping copy is not a data
+// race. Nothing here holds a pointer, so it can live in shared memory.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(uint64_t) == 0);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    static constexpr size_t WORDS = sizeof(T) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> seq_{ 0 };
+    std::atomic<uint64_t> words_[WORDS]{};
+
+public:
+    void store(const T& v) {
+        update([&](auto&& put) { put(0, &v, sizeof(T)); });
+    }
+
+    // Like store(), but rewrites only the parts of the value that f passes
+    // to put(offset, p, n), each a whole number of words. Readers see all
+    // of them or none.
+    template <typename F>
+    void update(F&& f) {
+        uint64_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        f([this](size_t offset, const void* p, size_t n) {
+            for (size_t i = 0; i < n / sizeof(uint64_t); ++i) {
+                uint64_t w;
+                std::memcpy(&w, static_cast<const char*>(p) + i * sizeof(uint64_t), sizeof(w));
+                words_[offset / sizeof(uint64_t) + i].store(w, std::memory_order_relaxed);
+            }
+        });
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // One attempt, which never waits: false if a store was under way or
+    // overlapped the copy.
+    bool try_load(T& out) const {
+        uint64_t s = seq_.load(std::memory_order_acquire);
+        if (s & 1) {
+            return false;
+        }
+        uint64_t w[WORDS];
+        for (size_t i = 0; i < WORDS; ++i) {
+            w[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) != s) {
+            return false;
+        }
+        std::memcpy(&out, w, sizeof(T));
+        return true;
+    }
+
+    // Retries until a copy is consistent.
+    T load() const {
+        T v;
+        while (!try_load(v)) {
+#if defined(__x86_64__) || defined(_M_X64)
+            _mm_pause();
+#endif
+        }
+        return v;
+    }
+
+    // Stores so far; 0 until the first.
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+};
+
+// A book's visible levels as of its last change.
+template <size_t Depth = BOOK_DEPTH>
+struct BookSnapshot {
+    uint64_t ts_recv;
+    uint32_t publisher_id;
+    uint32_t instrument_id;
+    uint32_t sequence;
+    // Resting in the whole book, not just the visible levels.
+    uint32_t orders;
+    // Bids best-first, then offers best-first, as OrderBook::snapshot().
+    std::array<PriceLevel, 2 * Depth> levels;
+};
+
+// The key is (publisher_id << 32) | instrument_id. A slot fills a cache
+// line of its own, so readers of one book never share a line with the
+// writer of another.
+template <size_t Depth = BOOK_DEPTH>
+struct alignas(64) BookSlot {
+    static constexpr size_t HEAD_BYTES = offsetof(BookSnapshot<Depth>, levels);
+    static_assert(HEAD_BYTES % sizeof(uint64_t) == 0 && sizeof(PriceLevel) % sizeof(uint64_t) == 0);
+
+    std::atomic<uint64_t> key{ 0 };
+    Seqlock<BookSnapshot<Depth>> snap;
+
+    // Writer side: stores m's header fields and the levels. The first
+    // store writes everything, and its release publishes the key with it;
+    // later ones rewrite only the levels i where changed(i).
+    template <typename Changed>
+    void publish(const MboMessage& m, size_t orders, const PriceLevel* levels, Changed&& changed) {
+        BookSnapshot<Depth> head;
+        head.ts_recv = m.ts_recv;
+        head.publisher_id = m.publisher_id;
+        head.instrument_id = m.instrument_id;
+        head.sequence = m.sequence;
+        head.orders = static_cast<uint32_t>(orders);
+        if (snap.version() == 0) {
+            key.store((static_cast<uint64_t>(m.publisher_id) << 32) | m.instrument_id, std::memory_order_relaxed);
+            std::copy(levels, levels + 2 * Depth, head.levels.begin());
+            snap.store(head);
+            return;
+        }
+        snap.update([&](auto&& put) {
+            put(0, &head, HEAD_BYTES);
+            for (size_t i = 0; i < 2 * Depth; ++i) {
+                if (changed(i)) {
+                    put(HEAD_BYTES + i * sizeof(PriceLevel), &levels[i], sizeof(PriceLevel));
+                }
+            }
+        });
+    }
+};
+
+// Fixed set of per-book snapshots that one reconstructing thread publishes
+// into and other threads poll. A slot is written only when its book's
+// visible levels change, and then only the levels that did, so each
+// publish must follow every change since the last. Book ids
+// (BookManager's order of first appearance) index the slots; books past
+// capacity are not published.
+template <size_t Depth = BOOK_DEPTH>
+class SnapshotBoard {
+public:
+    using Snapshot = BookSnapshot<Depth>;
+
+private:
+    size_t capacity_;
+    std::unique_ptr<BookSlot<Depth>[]> slots_;
+    std::atomic<size_t> used_{ 0 };
+
+public:
+    explicit SnapshotBoard(size_t capacity = 1024) : capacity_(capacity), slots_(new BookSlot<Depth>[capacity]) {}
+
+    size_t capacity() const { return capacity_; }
+
+    // Writer side.
+    template <typename Book>
+    void publish(uint32_t id, const Book& book, const MboMessage& m) {
+        if (id >= capacity_) {
+            return;
+        }
+        BookSlot<Depth>& s = slots_[id];
+        if (s.snap.version() == 0 && id >= used_.load(std::memory_order_relaxed)) {
+            used_.store(id + 1, std::memory_order_release);
+        }
+        const auto& changes = book.changes();
+        s.publish(m, book.orders(), book.snapshot().data(), [&](size_t i) { return changes[i]; });
+    }
+
+    // Reader side. Slots below books() may still be unpublished (version
+    // 0) if their book has not changed yet.
+    size_t books() const { return used_.load(std::memory_order_acquire); }
+
+    const Seqlock<Snapshot>& slot(size_t id) const { return slots_[id].snap; }
+
+    // The slot for a book, or null if it has not been published. The
+    // pointer stays valid for the board's lifetime, so pollers look it up
+    // once.
+    const Seqlock<Snapshot>* find(uint16_t publisher_id, uint32_t instrument_id) const {
+        uint64_t key = (static_cast<uint64_t>(publisher_id) << 32) | instrument_id;
+        for (size_t i = 0, n = books(); i < n; ++i) {
+            const BookSlot<Depth>& s = slots_[i];
+            if (s.snap.version() && s.key.load(std::memory_order_relaxed) == key) {
+                return &s.snap;
+            }
+        }
+        return nullptr;
+    }
+};
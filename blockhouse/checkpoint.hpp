@@ -0,0 +1,241 @@
+// checkpoint.hpp
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "book_manager.hpp"
+#include "mbo.hpp"
+
+// Binary image of every book's resting orders, taken between messages so
+// a later run can pick up where this one stopped instead of replaying the
+// input from its start. Fixed-size little-endian records, read in place
+// from a mapping:
+//
+//   CheckpointHeader
+//   per book: CheckpointBook, then per level a CheckpointLevel followed
+//   by its orders as CheckpointOrder, in queue order.
+static constexpr char CHECKPOINT_MAGIC[8] = { 'B', 'H', 'C', 'K', 'P', 'T', 0, 2 };
+
+struct CheckpointHeader {
+    char magic[8];
+    // Where the next message starts: bytes into the CSV text, or into the
+    // DBN records after the metadata.
+    uint64_t input_offset;
+    uint64_t messages;
+    uint32_t last_sequence;
+    uint32_t books;
+    // Input lines dropped so far (see Input::bad_lines).
+    uint64_t bad_lines;
+};
+
+struct CheckpointBook {
+    uint64_t key;
+    uint64_t levels;
+    uint64_t orders;
+    uint64_t trades;
+    uint64_t volume;
+    double notional;
+    // Feed counters (see feed_stats.hpp), so --feed-stats carries on.
+    uint64_t gaps;
+    uint64_t missing;
+    uint64_t regressions;
+    uint64_t unknown_orders;
+    uint32_t last_sequence;
+    uint8_t sequence_started;
+    uint8_t pad[3];
+};
+
+struct CheckpointLevel {
+    int64_t price;
+    uint32_t orders;
+    uint8_t side;
+    uint8_t pad[3];
+};
+
+struct CheckpointOrder {
+    uint64_t order_id;
+    uint32_t size;
+    uint8_t flags;
+    uint8_t pad[3];
+};
+
+static_assert(sizeof(CheckpointHeader) == 40 && sizeof(CheckpointBook) == 88 &&
+              sizeof(CheckpointLevel) == 16 && sizeof(CheckpointOrder) == 16);
+
+// Serializes books into checkpoint records, passed to put(data, size) in
+// file order.
+template <size_t Depth, typename Put>
+void write_checkpoint(const BookManager<Depth>& books, CheckpointHeader h, Put&& put) {
+    auto rec = [&](const auto& r) { put(&r, sizeof(r)); };
+    std::memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.books = static_cast<uint32_t>(books.books());
+    rec(h);
+    std::vector<CheckpointLevel> levels;
+    std::vector<CheckpointOrder> orders;
+    books.for_each_book([&](const auto& e) {
+        levels.clear();
+        orders.clear();
+        e.book.save(
+            [&](Side side, int64_t price, uint32_t n) {
+                levels.push_back({ price, n, static_cast<uint8_t>(side), {} });
+            },
+            [&](uint64_t order_id, uint32_t size, uint8_t flags) {
+                orders.push_back({ order_id, size, flags, {} });
+            });
+        const SequenceStats& s = e.sequence;
+        rec(CheckpointBook{ e.key, levels.size(), orders.size(), e.trades.trades, e.trades.volume,
+                            e.trades.notional, s.gaps, s.missing, s.regressions, e.book.unknown_orders(),
+                            s.last, static_cast<uint8_t>(s.started), {} });
+        const CheckpointOrder* o = orders.data();
+        for (const auto& l : levels) {
+            rec(l);
+            put(o, l.orders * sizeof(*o));
+            o += l.orders;
+        }
+    });
+}
+
+// Writes to path + ".tmp" and renames over path, so a crash mid-write
+// leaves the previous checkpoint intact. False on any I/O error.
+template <size_t Depth>
+bool save_checkpoint(const char* path, const BookManager<Depth>& books, const CheckpointHeader& h) {
+    std::string tmp = std::string(path) + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    std::vector<char> buf(1 << 20);
+    std::setvbuf(f, buf.data(), _IOFBF, buf.size());
+    bool ok = true;
+    write_checkpoint(books, h, [&](const void* p, size_t n) {
+        ok = ok && (n == 0 || std::fwrite(p, n, 1, f) == 1);
+    });
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(tmp.c_str(), path) == 0;
+}
+
+// Fills empty books from an image; false if it is truncated or
+// inconsistent, which leaves the books partly filled.
+template <size_t Depth>
+bool restore_checkpoint(const char* data, size_t size, BookManager<Depth>& books, CheckpointHeader& h) {
+    const char* p = data;
+    const char* end = data + size;
+    auto get = [&](auto& rec) {
+        if (static_cast<size_t>(end - p) < sizeof(rec)) {
+            return false;
+        }
+        std::memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        return true;
+    };
+    if (!get(h) || std::memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) {
+        return false;
+    }
+    for (uint32_t b = 0; b < h.books; ++b) {
+        CheckpointBook cb;
+        if (!get(cb)) {
+            return false;
+        }
+        auto& e = books.entry(cb.key);
+        e.trades = { cb.trades, cb.volume, cb.notional };
+        e.sequence.last = cb.last_sequence;
+        e.sequence.started = cb.sequence_started != 0;
+        e.sequence.gaps = cb.gaps;
+        e.sequence.missing = cb.missing;
+        e.sequence.regressions = cb.regressions;
+        e.book.reserve(cb.orders);
+        uint64_t orders = 0;
+        for (uint64_t i = 0; i < cb.levels; ++i) {
+            CheckpointLevel l;
+            if (!get(l) || (l.side != static_cast<uint8_t>(Side::B) && l.side != static_cast<uint8_t>(Side::A))) {
+                return false;
+            }
+            Side side = static_cast<Side>(l.side);
+            e.book.restore_level(side, l.price);
+            for (uint32_t k = 0; k < l.orders; ++k) {
+                CheckpointOrder o;
+                if (!get(o) || !e.book.restore_order(side, l.price, o.order_id, o.size, o.flags)) {
+                    return false;
+                }
+            }
+            orders += l.orders;
+        }
+        e.book.restore_done(cb.unknown_orders);
+        if (orders != cb.orders) {
+            return false;
+        }
+    }
+    return p == end;
+}
+
+// A checkpoint file, mapped read-only where the platform allows.
+class CheckpointImage {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<char> copy_;
+
+    CheckpointImage() = default;
+
+public:
+    ~CheckpointImage() {
+#if !defined(_WIN32)
+        if (copy_.empty() && data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    CheckpointImage(const CheckpointImage&) = delete;
+    CheckpointImage& operator=(const CheckpointImage&) = delete;
+
+    static std::unique_ptr<CheckpointImage> open(const char* path) {
+        std::unique_ptr<CheckpointImage> img(new CheckpointImage);
+#if !defined(_WIN32)
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        img->data_ = static_cast<const char*>(p);
+        img->size_ = static_cast<size_t>(st.st_size);
+#else
+        std::FILE* f = std::fopen(path, "rb");
+        if (!f) {
+            return nullptr;
+        }
+        char block[1 << 16];
+        for (size_t n; (n = std::fread(block, 1, sizeof(block), f)) > 0;) {
+            img->copy_.insert(img->copy_.end(), block, block + n);
+        }
+        std::fclose(f);
+        img->data_ = img->copy_.data();
+        img->size_ = img->copy_.size();
+#endif
+        return img;
+    }
+
+    // See restore_checkpoint().
+    template <size_t Depth>
+    bool restore(BookManager<Depth>& books, CheckpointHeader& h) const {
+        return restore_checkpoint(data_, size_, books, h);
+    }
+};
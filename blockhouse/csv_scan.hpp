@@ -0,0 +1,255 @@
+// csv_scan.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define BLOCKHOUSE_SCAN_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define BLOCKHOUSE_SCAN_NEON 1
+#endif
+
+// Structural scanning for CSV lines. A line is taken 64 bytes at a time,
+// each block turned into a bitmask of its separators, and the set bits
+// read off as field offsets, so a line is scanned once however many
+// fields it has. The mask kernel is picked at startup from what the CPU
+// supports.
+namespace csv_scan {
+
+static constexpr size_t BLOCK = 64;
+
+// Offsets of the first max occurrences of sep in [p, p + n), in order.
+// Returns how many were found.
+using FindFn = size_t (*)(const char* p, size_t n, char sep, uint32_t* out, size_t max);
+
+struct Kernel {
+    FindFn find;
+    const char* name;
+};
+
+namespace detail {
+
+#if defined(__GNUC__)
+#define BLOCKHOUSE_SCAN_INLINE inline __attribute__((always_inline))
+#else
+#define BLOCKHOUSE_SCAN_INLINE inline
+#endif
+
+inline unsigned lowest_bit(uint64_t m) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(m));
+#else
+    unsigned i = 0;
+    for (; !(m & 1); m >>= 1) {
+        ++i;
+    }
+    return i;
+#endif
+}
+
+// Walks p in blocks; Kernel::mask(block, sep) gives one bit per byte equal
+// to sep. The tail is copied into a padded block so no kernel reads past
+// the line.
+template <typename Kernel>
+BLOCKHOUSE_SCAN_INLINE size_t find(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    size_t found = 0;
+    for (size_t base = 0; base < n && found < max; base += BLOCK) {
+        uint64_t m;
+        if (n - base >= BLOCK) {
+            m = Kernel::mask(p + base, sep);
+        } else {
+            alignas(BLOCK) char tail[BLOCK];
+            std::memset(tail, sep ^ 1, BLOCK);
+            std::memcpy(tail, p + base, n - base);
+            m = Kernel::mask(tail, sep);
+        }
+        for (; m && found < max; m &= m - 1) {
+            out[found++] = static_cast<uint32_t>(base + lowest_bit(m));
+        }
+    }
+    return found;
+}
+
+struct Scalar {
+    static uint64_t mask(const char* b, char sep) {
+        uint64_t m = 0;
+        for (size_t i = 0; i < BLOCK; ++i) {
+            m |= static_cast<uint64_t>(b[i] == sep) << i;
+        }
+        return m;
+    }
+};
+
+#if defined(BLOCKHOUSE_SCAN_X86)
+// SSE2 is part of x86-64, so this needs no dispatch. The SSE4.2 string
+// instructions would be slower here than compare and movemask.
+struct Sse2 {
+    static BLOCKHOUSE_SCAN_INLINE uint64_t mask(const char* b, char sep) {
+        __m128i s = _mm_set1_epi8(sep);
+        uint64_t m = 0;
+        for (int i = 0; i < 4; ++i) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16 * i));
+            m |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, s)))) << (16 * i);
+        }
+        return m;
+    }
+};
+
+#if defined(__GNUC__)
+#define BLOCKHOUSE_SCAN_AVX2 1
+struct Avx2 {
+    __attribute__((target("avx2"))) static uint64_t mask(const char* b, char sep) {
+        __m256i s = _mm256_set1_epi8(sep);
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 32));
+        uint32_t mlo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, s)));
+        uint32_t mhi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, s)));
+        return mlo | static_cast<uint64_t>(mhi) << 32;
+    }
+};
+
+// flatten pulls find and mask into this AVX2 function, where they can
+// inline; find<Avx2> on its own would be compiled for the baseline target.
+__attribute__((target("avx2"), flatten)) inline size_t find_avx2(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    return find<Avx2>(p, n, sep, out, max);
+}
+#endif
+
+inline size_t find_sse2(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    return find<Sse2>(p, n, sep, out, max);
+}
+#endif
+
+#if defined(BLOCKHOUSE_SCAN_NEON)
+struct Neon {
+    static BLOCKHOUSE_SCAN_INLINE uint64_t mask(const char* b, char sep) {
+        static const uint8_t WEIGHTS[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        uint8x16_t s = vdupq_n_u8(static_cast<uint8_t>(sep));
+        uint8x16_t w = vld1q_u8(WEIGHTS);
+        uint8x16_t q[4];
+        for (int i = 0; i < 4; ++i) {
+            q[i] = vandq_u8(vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(b + 16 * i)), s), w);
+        }
+        // Pairwise sums fold each group of eight weighted bytes into one.
+        uint8x16_t sum = vpaddq_u8(vpaddq_u8(q[0], q[1]), vpaddq_u8(q[2], q[3]));
+        sum = vpaddq_u8(sum, sum);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+    }
+};
+
+inline size_t find_neon(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    return find<Neon>(p, n, sep, out, max);
+}
+#endif
+
+inline size_t find_scalar(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    return find<Scalar>(p, n, sep, out, max);
+}
+
+inline Kernel select() {
+#if defined(BLOCKHOUSE_SCAN_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return { find_avx2, "avx2" };
+    }
+#endif
+#if defined(BLOCKHOUSE_SCAN_X86)
+    return { find_sse2, "sse2" };
+#elif defined(BLOCKHOUSE_SCAN_NEON)
+    return { find_neon, "neon" };
+#else
+    return { find_scalar, "scalar" };
+#endif
+}
+
+inline const Kernel& kernel() {
+    static const Kernel k = select();
+    return k;
+}
+
+} // namespace detail
+
+// Every kernel this CPU can run, the chosen one first.
+inline std::vector<Kernel> kernels() {
+    std::vector<Kernel> all{ detail::kernel() };
+#if defined(BLOCKHOUSE_SCAN_X86)
+    if (all[0].find != detail::find_sse2) {
+        all.push_back({ detail::find_sse2, "sse2" });
+    }
+#endif
+    if (all[0].find != detail::find_scalar) {
+        all.push_back({ detail::find_scalar, "scalar" });
+    }
+    return all;
+}
+
+// The kernel this CPU runs.
+inline const char* kernel_name() { return detail::kernel().name; }
+
+inline size_t find(const char* p, size_t n, char sep, uint32_t* out, size_t max) {
+    return detail::kernel().find(p, n, sep, out, max);
+}
+
+// Up to 19 ASCII digits to an integer, eight at a time within a 64-bit
+// word. False unless every byte is a digit, so callers can fall back to a
+// general parser for signs and anything longer. before is how many bytes
+// ahead of p may be read: a short leading group with enough of them is
+// one load ending at its last digit, with the bytes ahead of it masked.
+inline bool parse_digits(const char* p, size_t n, uint64_t& out, size_t before = 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    static constexpr uint64_t ZEROS = 0x3030303030303030ull;
+    if (n == 0 || n > 19) {
+        return false;
+    }
+    // A group of len digits sits in bytes 8 - len .. 7, the first digit
+    // lowest, behind '0' padding.
+    auto group = [](uint64_t w, uint64_t& v) {
+        if ((w & 0xF0F0F0F0F0F0F0F0ull) != ZEROS || ((w + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) != ZEROS) {
+            return false;
+        }
+        w -= ZEROS;
+        w = w * 10 + (w >> 8);
+        v = (((w & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+             (((w >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+        return true;
+    };
+    size_t first = n % 8 ? n % 8 : 8;
+    uint64_t w;
+    if (first == 8 || before >= 8 - first) {
+        std::memcpy(&w, p + first - 8, 8);
+        uint64_t keep = first == 8 ? ~0ull : ~0ull << (8 * (8 - first));
+        w = (w & keep) | (ZEROS & ~keep);
+    } else {
+        w = ZEROS;
+        for (size_t i = 0; i < first; ++i) {
+            size_t shift = 8 * (8 - first + i);
+            w = (w & ~(0xFFull << shift)) | static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << shift;
+        }
+    }
+    uint64_t v;
+    if (!group(w, v)) {
+        return false;
+    }
+    for (size_t i = first; i < n; i += 8) {
+        uint64_t g;
+        std::memcpy(&w, p + i, 8);
+        if (!group(w, g)) {
+            return false;
+        }
+        v = v * 100000000ull + g;
+    }
+    out = v;
+    return true;
+#else
+    (void)p;
+    (void)n;
+    (void)out;
+    (void)before;
+    return false;
+#endif
+}
+
+} // namespace csv_scan
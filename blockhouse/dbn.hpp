@@ -0,0 +1,105 @@
+// dbn.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Databento Binary Encoding (DBN). Files start with "DBN" and a version
+// byte followed by a metadata block; after that comes a stream of
+// little-endian records, each prefixed by a header giving its length in
+// 4-byte words.
+
+static constexpr uint8_t DBN_VERSION = 2;
+static constexpr uint8_t DBN_RTYPE_MBP10 = 0x0A;
+static constexpr uint8_t DBN_RTYPE_MBO = 0xA0;
+static constexpr uint16_t DBN_SCHEMA_MBO = 0;
+static constexpr uint16_t DBN_SCHEMA_MBP10 = 2;
+static constexpr size_t DBN_V1_SYMBOL_CSTR_LEN = 22;
+static constexpr size_t DBN_SYMBOL_CSTR_LEN = 71;
+// The fixed metadata fields span the same 100 bytes in every version and
+// are followed by the (unused) schema definition.
+static constexpr size_t DBN_METADATA_FIXED_LEN = 100;
+static constexpr size_t DBN_V2_SYMBOL_CSTR_LEN_OFFSET = 45;
+static constexpr size_t DBN_MBP_LEVELS = 10;
+
+#pragma pack(push, 1)
+struct DbnRecordHeader {
+    uint8_t  length;
+    uint8_t  rtype;
+    uint16_t publisher_id;
+    uint32_t instrument_id;
+    uint64_t ts_event;
+};
+
+struct DbnMboRecord {
+    DbnRecordHeader hd;
+    uint64_t order_id;
+    int64_t  price;
+    uint32_t size;
+    uint8_t  flags;
+    uint8_t  channel_id;
+    char     action;
+    char     side;
+    uint64_t ts_recv;
+    int32_t  ts_in_delta;
+    uint32_t sequence;
+};
+
+struct DbnBidAskPair {
+    int64_t  bid_px;
+    int64_t  ask_px;
+    uint32_t bid_sz;
+    uint32_t ask_sz;
+    uint32_t bid_ct;
+    uint32_t ask_ct;
+};
+
+struct DbnMbp10Record {
+    DbnRecordHeader hd;
+    int64_t  price;
+    uint32_t size;
+    char     action;
+    char     side;
+    uint8_t  flags;
+    uint8_t  depth;
+    uint64_t ts_recv;
+    int32_t  ts_in_delta;
+    uint32_t sequence;
+    DbnBidAskPair levels[DBN_MBP_LEVELS];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(DbnRecordHeader) == 16);
+static_assert(sizeof(DbnMboRecord) == 56);
+static_assert(sizeof(DbnMbp10Record) == 368);
+
+// Metadata as written by encode_dbn_metadata(): prelude, fixed fields, then
+// empty schema definition, symbols, partial, not_found and mappings.
+static constexpr uint32_t DBN_EMPTY_METADATA_LEN = DBN_METADATA_FIXED_LEN + 5 * sizeof(uint32_t);
+
+namespace dbn_detail {
+
+template <typename T>
+inline char* put(char* p, T v) {
+    std::memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+} // namespace dbn_detail
+
+// Writes a DBN v2 metadata block with no symbology (instrument ids only)
+// and returns its end; out needs 8 + DBN_EMPTY_METADATA_LEN bytes.
+inline char* encode_dbn_metadata(char* out, uint16_t schema) {
+    using namespace dbn_detail;
+    std::memcpy(out, "DBN", 3);
+    out[3] = static_cast<char>(DBN_VERSION);
+    char* fixed = put(out + 4, DBN_EMPTY_METADATA_LEN);
+    std::memset(fixed, 0, DBN_EMPTY_METADATA_LEN);
+    char* p = fixed + 16;                   // dataset
+    p = put(p, schema);
+    p = put<uint64_t>(p, 0);                // start
+    p = put<uint64_t>(p, UINT64_MAX);       // end (unknown)
+    put<uint64_t>(p, 0);                    // limit; stype_in, stype_out, ts_out stay 0
+    put<uint16_t>(fixed + DBN_V2_SYMBOL_CSTR_LEN_OFFSET, DBN_SYMBOL_CSTR_LEN);
+    return fixed + DBN_EMPTY_METADATA_LEN;
+}
@@ -0,0 +1,362 @@
+// dbn_reader.hpp
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(BLOCKHOUSE_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "dbn.hpp"
+#include "instrument.hpp"
+#include "mbo.hpp"
+
+// Reads DBN files (see dbn.hpp). Only MBO records are decoded; anything
+// else is skipped by length. Link with -lzstd and define
+// BLOCKHOUSE_WITH_ZSTD to read .dbn.zst files.
+
+class ByteStream {
+public:
+    virtual ~ByteStream() = default;
+    // Reads up to n bytes; 0 means end of stream or error.
+    virtual size_t read(char* out, size_t n) = 0;
+    // True once a read returned 0 because of an error.
+    virtual bool failed() const { return false; }
+};
+
+class FileByteStream : public ByteStream {
+    std::FILE* file_;
+
+public:
+    explicit FileByteStream(std::FILE* file) : file_(file) {}
+    ~FileByteStream() override { std::fclose(file_); }
+
+    FileByteStream(const FileByteStream&) = delete;
+    FileByteStream& operator=(const FileByteStream&) = delete;
+
+    size_t read(char* out, size_t n) override { return std::fread(out, 1, n, file_); }
+    bool failed() const override { return std::ferror(file_) != 0; }
+};
+
+// Bytes already in memory, e.g. a file read in one go.
+class MemoryByteStream : public ByteStream {
+    const char* p_;
+    const char* end_;
+
+public:
+    MemoryByteStream(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    size_t read(char* out, size_t n) override {
+        n = std::min(n, static_cast<size_t>(end_ - p_));
+        std::memcpy(out, p_, n);
+        p_ += n;
+        return n;
+    }
+};
+
+#if defined(BLOCKHOUSE_WITH_ZSTD)
+// Streaming zstd decompression over another stream.
+class ZstdByteStream : public ByteStream {
+    std::unique_ptr<ByteStream> src_;
+    ZSTD_DStream* ds_;
+    std::vector<char> in_;
+    ZSTD_inBuffer pos_{ nullptr, 0, 0 };
+    bool eof_ = false;
+    // Corrupt input, or input that ends inside a frame.
+    bool error_ = false;
+    // 0 once the last frame started is fully decoded.
+    size_t pending_ = 0;
+
+public:
+    explicit ZstdByteStream(std::unique_ptr<ByteStream> src)
+        : src_(std::move(src)), ds_(ZSTD_createDStream()), in_(ZSTD_DStreamInSize()) {
+        ZSTD_initDStream(ds_);
+    }
+
+    ~ZstdByteStream() override { ZSTD_freeDStream(ds_); }
+
+    ZstdByteStream(const ZstdByteStream&) = delete;
+    ZstdByteStream& operator=(const ZstdByteStream&) = delete;
+
+    size_t read(char* out, size_t n) override {
+        ZSTD_outBuffer dst{ out, n, 0 };
+        while (dst.pos == 0) {
+            if (pos_.pos == pos_.size) {
+                if (eof_) {
+                    return 0;
+                }
+                size_t got = src_->read(in_.data(), in_.size());
+                if (got == 0) {
+                    eof_ = true;
+                }
+                pos_ = { in_.data(), got, 0 };
+            }
+            size_t in_before = pos_.pos, out_before = dst.pos;
+            size_t ret = ZSTD_decompressStream(ds_, &dst, &pos_);
+            if (ZSTD_isError(ret)) {
+                error_ = true;
+                return 0;
+            }
+            // A call that moved nothing only hints at a next frame.
+            if (pos_.pos != in_before || dst.pos != out_before) {
+                pending_ = ret;
+            }
+            if (eof_ && pos_.pos == pos_.size && dst.pos == 0) {
+                error_ = pending_ != 0;
+                return 0;
+            }
+        }
+        return dst.pos;
+    }
+
+    bool failed() const override { return error_ || src_->failed(); }
+};
+#endif
+
+class DbnReader {
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr uint32_t ZSTD_MAGIC = 0xFD2FB528;
+
+    std::unique_ptr<ByteStream> in_;
+    std::vector<char> buf_ = std::vector<char>(BUFFER_SIZE);
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    // Record bytes consumed after the metadata.
+    uint64_t position_ = 0;
+    uint8_t version_ = 0;
+    // The records stopped partway through one.
+    bool truncated_ = false;
+    std::unordered_map<uint32_t, FixedString<SYMBOL_LEN>> symbols_;
+
+    explicit DbnReader(std::unique_ptr<ByteStream> in) : in_(std::move(in)) {}
+
+    // Ensures n contiguous unread bytes are buffered.
+    bool fill(size_t n) {
+        if (end_ - begin_ >= n) {
+            return true;
+        }
+        std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (buf_.size() < n) {
+            buf_.resize(n);
+        }
+        while (end_ < n) {
+            size_t got = in_->read(buf_.data() + end_, buf_.size() - end_);
+            if (got == 0) {
+                return false;
+            }
+            end_ += got;
+        }
+        return true;
+    }
+
+    bool read_metadata() {
+        if (!fill(8) || std::memcmp(buf_.data(), "DBN", 3) != 0) {
+            return false;
+        }
+        version_ = static_cast<uint8_t>(buf_[3]);
+        uint32_t len;
+        std::memcpy(&len, buf_.data() + 4, 4);
+        begin_ += 8;
+        if (version_ < 1 || len < DBN_METADATA_FIXED_LEN || !fill(len)) {
+            return false;
+        }
+        const char* p = buf_.data() + begin_;
+        const char* end = p + len;
+        begin_ += len;
+
+        size_t cstr_len = DBN_V1_SYMBOL_CSTR_LEN;
+        if (version_ >= 2) {
+            uint16_t v;
+            std::memcpy(&v, p + DBN_V2_SYMBOL_CSTR_LEN_OFFSET, 2);
+            cstr_len = v;
+        }
+        p += DBN_METADATA_FIXED_LEN;
+        auto u32 = [&](uint32_t& v) {
+            if (end - p < 4) {
+                return false;
+            }
+            std::memcpy(&v, p, 4);
+            p += 4;
+            return true;
+        };
+        auto cstr = [&](std::string_view& s) {
+            if (static_cast<size_t>(end - p) < cstr_len) {
+                return false;
+            }
+            auto nul = static_cast<const char*>(std::memchr(p, '\0', cstr_len));
+            s = std::string_view(p, nul ? static_cast<size_t>(nul - p) : cstr_len);
+            p += cstr_len;
+            return true;
+        };
+        uint32_t n;
+        if (!u32(n) || static_cast<size_t>(end - p) < n) {
+            return false;
+        }
+        p += n;
+        std::string_view s;
+        // symbols, partial, not_found
+        for (int list = 0; list < 3; ++list) {
+            if (!u32(n)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                if (!cstr(s)) {
+                    return false;
+                }
+            }
+        }
+        if (!u32(n)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            std::string_view raw;
+            uint32_t intervals;
+            if (!cstr(raw) || !u32(intervals)) {
+                return false;
+            }
+            for (uint32_t j = 0; j < intervals; ++j) {
+                uint32_t start_date, end_date;
+                if (!u32(start_date) || !u32(end_date) || !cstr(s)) {
+                    return false;
+                }
+                // With stype_out instrument_id each interval names the id.
+                uint32_t id;
+                auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), id);
+                if (ec == std::errc() && ptr == s.data() + s.size()) {
+                    symbols_[id].assign(raw.substr(0, SYMBOL_LEN));
+                }
+            }
+        }
+        return true;
+    }
+
+    void decode(const DbnMboRecord& r, MboMessage& m) const {
+        m.ts_recv = r.ts_recv;
+        m.ts_event = r.hd.ts_event;
+        m.rtype = r.hd.rtype;
+        m.publisher_id = r.hd.publisher_id;
+        m.instrument_id = r.hd.instrument_id;
+        m.action = static_cast<Action>(r.action);
+        m.side = static_cast<Side>(r.side);
+        m.depth = 0;
+        m.price = r.price;
+        m.size = r.size;
+        m.flags = r.flags;
+        m.ts_in_delta = r.ts_in_delta;
+        m.sequence = r.sequence;
+        auto sym = symbols_.find(r.hd.instrument_id);
+        if (sym != symbols_.end()) {
+            m.symbol = sym->second;
+        } else {
+            m.symbol.len = 0;
+        }
+        m.order_id = r.order_id;
+    }
+
+public:
+    // Opens a plain or zstd-compressed DBN file, detected by its magic.
+    static std::unique_ptr<DbnReader> open(const char* path) {
+        std::FILE* f = std::fopen(path, "rb");
+        if (!f) {
+            return nullptr;
+        }
+        uint32_t magic = 0;
+        bool zstd = std::fread(&magic, 1, 4, f) == 4 && magic == ZSTD_MAGIC;
+        std::rewind(f);
+        return open(std::make_unique<FileByteStream>(f), zstd);
+    }
+
+    // The same for a file already in memory, which must outlive the reader.
+    static std::unique_ptr<DbnReader> open(std::string_view bytes) {
+        uint32_t magic = 0;
+        if (bytes.size() >= 4) {
+            std::memcpy(&magic, bytes.data(), 4);
+        }
+        return open(std::make_unique<MemoryByteStream>(bytes.data(), bytes.size()), magic == ZSTD_MAGIC);
+    }
+
+    static std::unique_ptr<DbnReader> open(std::unique_ptr<ByteStream> in, bool zstd) {
+        if (zstd) {
+#if defined(BLOCKHOUSE_WITH_ZSTD)
+            in = std::make_unique<ZstdByteStream>(std::move(in));
+#else
+            return nullptr;
+#endif
+        }
+        std::unique_ptr<DbnReader> r(new DbnReader(std::move(in)));
+        if (!r->read_metadata()) {
+            return nullptr;
+        }
+        return r;
+    }
+
+    uint8_t version() const { return version_; }
+
+    // Offset of the next record, counted from the end of the metadata.
+    uint64_t position() const { return position_; }
+
+    // Skips n bytes of records, for resuming at a saved position().
+    bool skip(uint64_t n) {
+        while (n) {
+            size_t step = static_cast<size_t>(std::min<uint64_t>(n, BUFFER_SIZE));
+            if (!fill(step)) {
+                return false;
+            }
+            begin_ += step;
+            position_ += step;
+            n -= step;
+        }
+        return true;
+    }
+
+    // True if the input could not be read to its end, or ended inside a
+    // record: the messages before that were all delivered.
+    bool failed() const { return truncated_ || in_->failed(); }
+
+    // Calls fn for every MBO record until the stream ends.
+    template <typename F>
+    void for_each(F&& fn) {
+        MboMessage m;
+        DbnMboRecord rec;
+        while (true) {
+            if (!fill(sizeof(DbnRecordHeader))) {
+                truncated_ = end_ != begin_;
+                return;
+            }
+            size_t len = static_cast<size_t>(static_cast<uint8_t>(buf_[begin_])) * 4;
+            if (len < sizeof(DbnRecordHeader) || !fill(len)) {
+                truncated_ = true;
+                return;
+            }
+            const char* p = buf_.data() + begin_;
+            begin_ += len;
+            position_ += len;
+            if (static_cast<uint8_t>(p[1]) != DBN_RTYPE_MBO || len < sizeof(DbnMboRecord)) {
+                continue;
+            }
+            {
+                instrument::Timer timer(instrument::PARSE);
+                std::memcpy(&rec, p, sizeof(rec));
+                decode(rec, m);
+            }
+            fn(m);
+        }
+    }
+};
+
+// True for .dbn and .dbn.zst paths.
+inline bool is_dbn_path(std::string_view path) {
+    auto ends_with = [&](std::string_view suffix) {
+        return path.size() >= suffix.size() && path.substr(path.size() - suffix.size()) == suffix;
+    };
+    return ends_with(".dbn") || ends_with(".dbn.zst");
+}
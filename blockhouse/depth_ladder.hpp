@@ -0,0 +1,128 @@
+// depth_ladder.hpp
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Resting size and order count summed over a range of prices.
+struct DepthSum {
+    uint64_t size = 0;
+    uint64_t orders = 0;
+};
+
+// Fenwick trees of one book side's resting size and order count over a
+// fixed window of price ticks, so depth across a price range is summed
+// in O(log ticks) instead of by walking every level in it. The window is
+// centred on the first price added to an empty side. Orders outside it
+// are only counted, and a range that reaches past the window is answered
+// only while there are none. Orders at a price off the tick grid are
+// counted too, and while any rest no range is answered.
+class DepthLadder {
+    int64_t tick_ = 0;
+    // Price of slot 0; valid while orders_ is non-zero.
+    int64_t low_ = 0;
+    uint64_t orders_ = 0;
+    uint64_t outside_ = 0;
+    uint64_t off_grid_ = 0;
+    // 1-based Fenwick trees, one entry per tick.
+    std::vector<uint64_t> size_;
+    std::vector<uint64_t> count_;
+
+    size_t ticks() const { return size_.size() - 1; }
+
+    // Slot of the first tick at or above price (at or below with
+    // round_up false), clamped to [-1, ticks()]: past the window either
+    // way is all callers need. The distance from low_ is taken unsigned,
+    // so no price overflows it.
+    int64_t slot(int64_t price, bool round_up) const {
+        auto t = static_cast<uint64_t>(tick_);
+        auto n = static_cast<uint64_t>(ticks());
+        if (price >= low_) {
+            uint64_t d = static_cast<uint64_t>(price) - static_cast<uint64_t>(low_);
+            uint64_t q = d / t + (round_up && d % t != 0);
+            return static_cast<int64_t>(std::min(q, n));
+        }
+        uint64_t d = static_cast<uint64_t>(low_) - static_cast<uint64_t>(price);
+        return round_up && d < t ? 0 : -1;
+    }
+
+    static uint64_t prefix(const std::vector<uint64_t>& tree, size_t i) {
+        uint64_t sum = 0;
+        for (; i; i &= i - 1) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+public:
+    // Indexes ticks ticks of tick price units each; a tick of 0 or less
+    // turns the ladder off. Call on an empty side, or replay the side's
+    // levels through add() afterwards.
+    void enable(int64_t tick, size_t ticks) {
+        tick_ = ticks && tick > 0 ? tick : 0;
+        size_.assign(tick_ ? ticks + 1 : 0, 0);
+        count_.assign(size_.size(), 0);
+        orders_ = outside_ = off_grid_ = 0;
+    }
+
+    bool enabled() const { return tick_ != 0; }
+
+    void clear() {
+        std::fill(size_.begin(), size_.end(), 0);
+        std::fill(count_.begin(), count_.end(), 0);
+        orders_ = outside_ = off_grid_ = 0;
+    }
+
+    // A level's size changed by size and its order count by orders.
+    void add(int64_t price, int64_t size, int64_t orders) {
+        if (orders_ == 0) {
+            // Empty, so every tree entry is zero: re-centre on price,
+            // stopping short of the lowest tick an int64 holds.
+            int64_t q = price / tick_;
+            int64_t min = std::numeric_limits<int64_t>::min() / tick_;
+            int64_t half = static_cast<int64_t>(ticks() / 2);
+            low_ = (q < min + half ? min : q - half) * tick_;
+        }
+        orders_ += static_cast<uint64_t>(orders);
+        if (price % tick_ != 0) {
+            off_grid_ += static_cast<uint64_t>(orders);
+            return;
+        }
+        int64_t s = slot(price, false);
+        if (s < 0 || s >= static_cast<int64_t>(ticks())) {
+            outside_ += static_cast<uint64_t>(orders);
+            return;
+        }
+        for (size_t i = static_cast<size_t>(s) + 1; i < size_.size(); i += i & (~i + 1)) {
+            size_[i] += static_cast<uint64_t>(size);
+            count_[i] += static_cast<uint64_t>(orders);
+        }
+    }
+
+    // Sums the orders priced in [lo, hi]; false if the ladder cannot tell.
+    bool sum(int64_t lo, int64_t hi, DepthSum& out) const {
+        out = {};
+        if (off_grid_ || lo > hi) {
+            return !off_grid_;
+        }
+        if (orders_ == 0) {
+            return true;
+        }
+        int64_t a = slot(lo, true);
+        int64_t b = slot(hi, false);
+        int64_t n = static_cast<int64_t>(ticks());
+        if ((a < 0 || b >= n) && outside_) {
+            return false;
+        }
+        a = std::max<int64_t>(a, 0);
+        b = std::min(b, n - 1);
+        if (a > b) {
+            return true;
+        }
+        out.size = prefix(size_, static_cast<size_t>(b) + 1) - prefix(size_, static_cast<size_t>(a));
+        out.orders = prefix(count_, static_cast<size_t>(b) + 1) - prefix(count_, static_cast<size_t>(a));
+        return true;
+    }
+};
@@ -0,0 +1,44 @@
+// feed_stats.hpp
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// Tracks one book's sequence numbers to tell a lossy feed from a clean
+// one. Messages from one event may share a number, so only a jump past
+// last + 1 is a gap; a number below the highest seen is a regression
+// (a replay or reordering) and does not move the high mark.
+struct SequenceStats {
+    uint32_t last = 0;
+    bool started = false;
+    uint64_t gaps = 0;
+    // Sequence numbers skipped over by the gaps.
+    uint64_t missing = 0;
+    uint64_t regressions = 0;
+
+    void add(uint32_t seq) {
+        // One compare on the usual path: seq is last or last + 1.
+        if (seq - last <= 1 && started) {
+            last = seq;
+            return;
+        }
+        note(seq);
+    }
+
+private:
+    void note(uint32_t seq) {
+        if (!started) {
+            started = true;
+        } else if (seq > last) {
+            ++gaps;
+            missing += seq - last - 1;
+        } else {
+            ++regressions;
+            return;
+        }
+        last = seq;
+    }
+};
+
+// The column header Databento and this repo's tools put first in a CSV
+// file; the one line that fails to parse without being bad input.
+inline bool is_csv_header(std::string_view line) { return line.substr(0, 7) == "ts_recv"; }
@@ -0,0 +1,120 @@
+// generate.cpp
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "dbn.hpp"
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+#include "synthetic.hpp"
+
+// Writes a synthetic MBO stream to stdout as CSV (reconstruct's input
+// layout) or DBN. The same options and seed always give the same bytes.
+
+struct Options {
+    uint64_t messages = 1000000;
+    bool dbn = false;
+    SyntheticConfig cfg;
+};
+
+static bool parse_double(std::string_view s, double& v) {
+    std::string text(s);
+    char* end = nullptr;
+    v = std::strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size();
+}
+
+static bool parse_probability(std::string_view s, double& v) {
+    return parse_double(s, v) && v >= 0 && v <= 1;
+}
+
+static bool parse_args(int argc, char* argv[], Options& opt) {
+    SyntheticConfig& c = opt.cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string_view val = argv[++i];
+        bool ok = true;
+        if (arg == "--messages") {
+            ok = mbo_detail::parse_int(val, opt.messages);
+        } else if (arg == "--seed") {
+            ok = mbo_detail::parse_int(val, c.seed);
+        } else if (arg == "--instruments") {
+            ok = mbo_detail::parse_int(val, c.instruments) && c.instruments > 0;
+        } else if (arg == "--rate") {
+            ok = parse_double(val, c.rate) && c.rate > 0;
+        } else if (arg == "--levels") {
+            ok = mbo_detail::parse_int(val, c.levels) && c.levels > 0;
+        } else if (arg == "--depth-decay") {
+            ok = parse_probability(val, c.depth_decay);
+        } else if (arg == "--max-size") {
+            ok = mbo_detail::parse_int(val, c.max_size) && c.max_size > 0;
+        } else if (arg == "--cancel") {
+            ok = parse_probability(val, c.cancel);
+        } else if (arg == "--modify") {
+            ok = parse_probability(val, c.modify);
+        } else if (arg == "--move") {
+            ok = parse_probability(val, c.move);
+        } else if (arg == "--trade") {
+            ok = parse_probability(val, c.trade);
+        } else if (arg == "--clear") {
+            ok = parse_probability(val, c.clear);
+        } else if (arg == "--format") {
+            opt.dbn = val == "dbn";
+            ok = opt.dbn || val == "csv";
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return c.cancel + c.modify + c.trade + c.clear <= 1;
+}
+
+static DbnMboRecord to_dbn(const MboMessage& m) {
+    DbnMboRecord r{};
+    r.ts_recv = m.ts_recv;
+    r.hd = { sizeof(DbnMboRecord) / 4, DBN_RTYPE_MBO, m.publisher_id, m.instrument_id, m.ts_event };
+    r.order_id = m.order_id;
+    r.price = m.price;
+    r.size = m.size;
+    r.flags = m.flags;
+    r.action = static_cast<char>(m.action);
+    r.side = static_cast<char>(m.side);
+    r.ts_in_delta = m.ts_in_delta;
+    r.sequence = m.sequence;
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        std::fprintf(stderr,
+                     "usage: %s [--messages N] [--seed N] [--instruments N] [--rate MSGS_PER_SEC]\n"
+                     "          [--levels N] [--depth-decay P] [--max-size N] [--cancel P] [--modify P]\n"
+                     "          [--move P] [--trade P] [--clear P] [--format csv|dbn]\n",
+                     argv[0]);
+        return EXIT_FAILURE;
+    }
+    OutputBuffer out;
+    SyntheticMbo gen(opt.cfg);
+    if (opt.dbn) {
+        out.commit(encode_dbn_metadata(out.reserve(8 + DBN_EMPTY_METADATA_LEN), DBN_SCHEMA_MBO));
+    } else {
+        out.append(MBO_CSV_HEADER);
+    }
+    for (uint64_t i = 0; i < opt.messages; ++i) {
+        const MboMessage& m = gen.next();
+        if (opt.dbn) {
+            DbnMboRecord r = to_dbn(m);
+            out.append(reinterpret_cast<const char*>(&r), sizeof(r));
+        } else {
+            out.commit(format_mbo_csv(out.reserve(MAX_MBO_CSV_LEN), m));
+        }
+    }
+    return out.flush() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
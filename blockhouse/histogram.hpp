@@ -0,0 +1,81 @@
+// histogram.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram (HDR-style): exact below 32, then 32 sub-buckets
+// per power of two, so every value lands within ~3%. Fixed size and
+// allocation-free, cheap enough to record on the hot path.
+class Histogram {
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr uint64_t SUB = 1u << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    uint64_t counts_[BUCKETS] = {};
+    uint64_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+
+    // Index of the top set bit; v is not 0.
+    static unsigned highest_bit(uint64_t v) {
+#if defined(__GNUC__)
+        return 63 - static_cast<unsigned>(__builtin_clzll(v));
+#else
+        unsigned i = 0;
+        while (v >>= 1) {
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    static size_t bucket(uint64_t v) {
+        if (v < SUB) {
+            return static_cast<size_t>(v);
+        }
+        unsigned shift = highest_bit(v) - SUB_BITS;
+        return (shift + 1) * SUB + static_cast<size_t>((v >> shift) - SUB);
+    }
+
+    static uint64_t lower_bound(size_t i) {
+        if (i < SUB) {
+            return i;
+        }
+        unsigned shift = static_cast<unsigned>(i / SUB - 1);
+        return (i % SUB + SUB) << shift;
+    }
+
+public:
+    void record(uint64_t v) {
+        ++counts_[bucket(v)];
+        ++total_;
+        sum_ += v;
+        max_ = v > max_ ? v : max_;
+    }
+
+    void merge(const Histogram& o) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts_[i] += o.counts_[i];
+        }
+        total_ += o.total_;
+        sum_ += o.sum_;
+        max_ = o.max_ > max_ ? o.max_ : max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? static_cast<double>(sum_) / static_cast<double>(total_) : 0; }
+
+    // Smallest recorded bucket holding at least fraction q of the values.
+    uint64_t quantile(double q) const {
+        uint64_t want = static_cast<uint64_t>(q * static_cast<double>(total_));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen > want) {
+                return lower_bound(i);
+            }
+        }
+        return max_;
+    }
+};
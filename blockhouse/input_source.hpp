@@ -0,0 +1,250 @@
+// input_source.hpp
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A source hands out runs of whole lines. Only the final chunk may end
+// without a newline. A chunk stays valid until the next call.
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+    virtual bool next_chunk(std::string_view& chunk) = 0;
+    // Total input bytes if known up front, else 0.
+    virtual size_t size_hint() const { return 0; }
+    // True if chunks stay valid for the source's lifetime, not just until
+    // the next call.
+    virtual bool stable() const { return false; }
+    // Drops the first n bytes before the first next_chunk(), for resuming
+    // part way through; false if the source cannot or is shorter.
+    virtual bool skip(uint64_t n) { return n == 0; }
+    // The errno of a read error that ended the input early, else 0.
+    virtual int error() const { return 0; }
+};
+
+// Reads large blocks from a FILE* and carries the partial last line over
+// to the next block, so lines are never copied one at a time. On POSIX
+// each block is a single read(), so a pipe or terminal hands over its
+// lines as they arrive instead of once a whole block has filled.
+class BlockReadSource : public InputSource {
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    std::FILE* file_;
+    bool owns_;
+    std::vector<char> buf_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+    int error_ = 0;
+
+    static const char* find_last_newline(const char* p, size_t n) {
+        while (n) {
+            if (p[--n] == '\n') {
+                return p + n;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    explicit BlockReadSource(std::FILE* file, bool owns = true)
+        : file_(file), owns_(owns), buf_(BLOCK_SIZE) {
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+    }
+
+    ~BlockReadSource() override {
+        if (owns_) {
+            std::fclose(file_);
+        }
+    }
+
+    BlockReadSource(const BlockReadSource&) = delete;
+    BlockReadSource& operator=(const BlockReadSource&) = delete;
+
+    static std::unique_ptr<BlockReadSource> open(const char* path) {
+        std::FILE* f = std::fopen(path, "rb");
+        if (!f) {
+            return nullptr;
+        }
+        return std::make_unique<BlockReadSource>(f);
+    }
+
+    bool skip(uint64_t n) override {
+        if (n <= static_cast<uint64_t>(LONG_MAX) && std::fseek(file_, static_cast<long>(n), SEEK_CUR) == 0) {
+            return true;
+        }
+        // Not seekable: read through.
+        while (n) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(n, buf_.size()));
+            size_t got = std::fread(buf_.data(), 1, want, file_);
+            if (got == 0) {
+                return false;
+            }
+            n -= got;
+        }
+        return true;
+    }
+
+    bool next_chunk(std::string_view& chunk) override {
+        size_t carry = end_ - begin_;
+        std::memmove(buf_.data(), buf_.data() + begin_, carry);
+        begin_ = 0;
+        end_ = carry;
+        while (!eof_) {
+            if (end_ == buf_.size()) {
+                buf_.resize(buf_.size() * 2);
+            }
+#if defined(_WIN32)
+            size_t n = std::fread(buf_.data() + end_, 1, buf_.size() - end_, file_);
+            if (n == 0 && std::ferror(file_)) {
+                error_ = EIO;
+            }
+#else
+            auto got = ::read(::fileno(file_), buf_.data() + end_, buf_.size() - end_);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                error_ = errno;
+            }
+            size_t n = got > 0 ? static_cast<size_t>(got) : 0;
+#endif
+            if (n == 0) {
+                eof_ = true;
+                break;
+            }
+            // Only the newly read bytes can hold a newline the carry lacked.
+            const char* nl = find_last_newline(buf_.data() + end_, n);
+            end_ += n;
+            if (nl) {
+                begin_ = static_cast<size_t>(nl - buf_.data()) + 1;
+                chunk = { buf_.data(), begin_ };
+                return true;
+            }
+        }
+        chunk = { buf_.data(), end_ };
+        begin_ = end_;
+        return !chunk.empty();
+    }
+
+    int error() const override { return error_; }
+};
+
+#if !defined(_WIN32)
+// Maps the whole file read-only and hands it out as a single chunk; the
+// kernel is told the access is sequential so it reads ahead aggressively
+// and drops pages behind the scan.
+class MappedFileSource : public InputSource {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t start_ = 0;
+    bool done_ = false;
+
+    MappedFileSource(const char* data, size_t size) : data_(data), size_(size) {}
+
+public:
+    ~MappedFileSource() override {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFileSource(const MappedFileSource&) = delete;
+    MappedFileSource& operator=(const MappedFileSource&) = delete;
+
+    static std::unique_ptr<MappedFileSource> open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        ::madvise(p, size, MADV_SEQUENTIAL);
+        ::madvise(p, size, MADV_WILLNEED);
+        return std::unique_ptr<MappedFileSource>(new MappedFileSource(static_cast<const char*>(p), size));
+    }
+
+    bool next_chunk(std::string_view& chunk) override {
+        if (done_) {
+            return false;
+        }
+        done_ = true;
+        chunk = { data_ + start_, size_ - start_ };
+        return true;
+    }
+
+    bool skip(uint64_t n) override {
+        if (n > size_ - start_) {
+            return false;
+        }
+        start_ += static_cast<size_t>(n);
+        return true;
+    }
+
+    size_t size_hint() const override { return size_; }
+    bool stable() const override { return true; }
+};
+#endif
+
+// Prefers a mapping; falls back to block reads for pipes, empty files and
+// platforms without mmap. "-" streams stdin.
+inline std::unique_ptr<InputSource> open_input(const char* path) {
+    if (std::string_view(path) == "-") {
+        return std::make_unique<BlockReadSource>(stdin, false);
+    }
+#if !defined(_WIN32)
+    if (auto src = MappedFileSource::open(path)) {
+        return src;
+    }
+#endif
+    return BlockReadSource::open(path);
+}
+
+template <typename F>
+void for_each_line(std::string_view text, F&& fn) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        auto nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) {
+            nl = end;
+        }
+        fn(std::string_view(p, static_cast<size_t>(nl - p)));
+        p = nl + 1;
+    }
+}
+
+// Calls fn for every line, then end_of_chunk once each chunk is done.
+template <typename F, typename G>
+void for_each_line(InputSource& in, F&& fn, G&& end_of_chunk) {
+    std::string_view chunk;
+    while (in.next_chunk(chunk)) {
+        for_each_line(chunk, fn);
+        end_of_chunk();
+    }
+}
+
+template <typename F>
+void for_each_line(InputSource& in, F&& fn) {
+    for_each_line(in, fn, [] {});
+}
@@ -0,0 +1,182 @@
+// instrument.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(BLOCKHOUSE_INSTRUMENT)
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#include "histogram.hpp"
+#include "mbo.hpp"
+
+// Hot-path timing, compiled in with -DBLOCKHOUSE_INSTRUMENT. Each thread
+// records into its own histograms, merged only for the report. Without
+// the define every probe is an empty inline and compiles away.
+namespace instrument {
+
+#if defined(BLOCKHOUSE_INSTRUMENT)
+static constexpr bool ENABLED = true;
+#else
+static constexpr bool ENABLED = false;
+#endif
+
+enum Probe : uint8_t {
+    PARSE,
+    WRITE,
+    APPLY_ADD,
+    APPLY_CANCEL,
+    APPLY_MODIFY,
+    APPLY_CLEAR,
+    APPLY_TRADE,
+    APPLY_FILL,
+    APPLY_OTHER,
+    PROBES
+};
+
+inline Probe apply_probe(Action a) {
+    switch (a) {
+        case Action::A: return APPLY_ADD;
+        case Action::C: return APPLY_CANCEL;
+        case Action::M: return APPLY_MODIFY;
+        case Action::R: return APPLY_CLEAR;
+        case Action::T: return APPLY_TRADE;
+        case Action::F: return APPLY_FILL;
+        default:        return APPLY_OTHER;
+    }
+}
+
+// Aggregates over every book, sampled when the run ends.
+struct BookGauges {
+    size_t books = 0;
+    size_t orders = 0;
+    size_t bid_levels = 0;
+    size_t ask_levels = 0;
+    double max_index_load = 0;
+
+    template <typename Book>
+    void add(const Book& b) {
+        ++books;
+        orders += b.orders();
+        bid_levels += b.levels(Side::B);
+        ask_levels += b.levels(Side::A);
+        max_index_load = b.index_load() > max_index_load ? b.index_load() : max_index_load;
+    }
+};
+
+#if defined(BLOCKHOUSE_INSTRUMENT)
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct Registry {
+    Histogram probes[PROBES];
+};
+
+struct Registries {
+    std::mutex lock;
+    std::vector<std::unique_ptr<Registry>> all;
+    std::atomic<uint64_t> bytes_written{ 0 };
+    uint64_t start_ticks = ticks();
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+inline Registries& registries() {
+    static Registries r;
+    return r;
+}
+
+// This thread's histograms; they outlive the thread for the report.
+inline Registry& local() {
+    thread_local Registry* r = [] {
+        Registries& g = registries();
+        std::lock_guard<std::mutex> guard(g.lock);
+        g.all.push_back(std::make_unique<Registry>());
+        return g.all.back().get();
+    }();
+    return *r;
+}
+
+class Timer {
+    Probe probe_;
+    uint64_t start_;
+
+public:
+    explicit Timer(Probe p) : probe_(p), start_(ticks()) {}
+    ~Timer() { local().probes[probe_].record(ticks() - start_); }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+};
+
+inline void count_bytes(size_t n) { registries().bytes_written.fetch_add(n, std::memory_order_relaxed); }
+
+// Per-probe latencies in nanoseconds, then the gauges. Call once every
+// recording thread has finished.
+inline void report(std::FILE* out, const BookGauges& g) {
+    static const char* const NAMES[PROBES] = {
+        "parse", "write", "apply.add", "apply.cancel", "apply.modify",
+        "apply.clear", "apply.trade", "apply.fill", "apply.other",
+    };
+    Registries& reg = registries();
+    double elapsed_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                std::chrono::steady_clock::now() - reg.start_time).count());
+    uint64_t elapsed_ticks = ticks() - reg.start_ticks;
+    double ns_per_tick = elapsed_ticks ? elapsed_ns / static_cast<double>(elapsed_ticks) : 1;
+    Histogram merged[PROBES];
+    {
+        std::lock_guard<std::mutex> guard(reg.lock);
+        for (const auto& r : reg.all) {
+            for (size_t p = 0; p < PROBES; ++p) {
+                merged[p].merge(r->probes[p]);
+            }
+        }
+    }
+    std::fprintf(out, "%-14s %12s %9s %9s %9s %9s %9s %11s\n",
+                 "probe", "count", "mean_ns", "p50", "p90", "p99", "p99.9", "max");
+    for (size_t p = 0; p < PROBES; ++p) {
+        const Histogram& h = merged[p];
+        if (!h.count()) {
+            continue;
+        }
+        auto ns = [&](uint64_t t) { return static_cast<double>(t) * ns_per_tick; };
+        std::fprintf(out, "%-14s %12llu %9.1f %9.0f %9.0f %9.0f %9.0f %11.0f\n", NAMES[p],
+                     static_cast<unsigned long long>(h.count()), h.mean() * ns_per_tick,
+                     ns(h.quantile(0.5)), ns(h.quantile(0.9)), ns(h.quantile(0.99)),
+                     ns(h.quantile(0.999)), ns(h.max()));
+    }
+    std::fprintf(out, "books %zu, resting orders %zu, bid levels %zu, ask levels %zu, max index load %.2f\n",
+                 g.books, g.orders, g.bid_levels, g.ask_levels, g.max_index_load);
+    std::fprintf(out, "bytes written %llu\n",
+                 static_cast<unsigned long long>(reg.bytes_written.load(std::memory_order_relaxed)));
+}
+
+#else
+
+class Timer {
+public:
+    explicit Timer(Probe) {}
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+};
+
+inline void count_bytes(size_t) {}
+inline void report(std::FILE*, const BookGauges&) {}
+
+#endif
+
+} // namespace instrument
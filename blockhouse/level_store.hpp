@@ -0,0 +1,82 @@
+// level_store.hpp
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Storage policies for one side of an OrderBook. Each exposes the subset
+// of the std::map interface the book uses, iterating best price first
+// under Compare.
+
+struct MapLevels {
+    template <typename Level, typename Compare>
+    using type = std::map<int64_t, Level, Compare>;
+};
+
+// Levels in one contiguous vector, stored worst-to-best so the touch sits
+// at the back: inserts and erases near the touch move only a few
+// elements, and best-price access stays within a few cache lines.
+template <typename Level, typename Compare>
+class SortedLevels {
+    using Storage = std::vector<std::pair<int64_t, Level>>;
+
+    // Levels this close to the touch are found by a linear scan before
+    // falling back to a binary search.
+    static constexpr size_t LINEAR_SCAN = 8;
+
+    Storage v_;
+    Compare comp_;
+
+public:
+    using iterator = typename Storage::reverse_iterator;
+    using const_iterator = typename Storage::const_reverse_iterator;
+
+    iterator begin() { return v_.rbegin(); }
+    iterator end() { return v_.rend(); }
+    const_iterator begin() const { return v_.rbegin(); }
+    const_iterator end() const { return v_.rend(); }
+
+    Compare key_comp() const { return comp_; }
+    bool empty() const { return v_.empty(); }
+    size_t size() const { return v_.size(); }
+    void clear() { v_.clear(); }
+
+    // First level, best-first, whose price is not better than price.
+    iterator lower_bound(int64_t price) {
+        auto it = begin();
+        size_t n = std::min(v_.size(), LINEAR_SCAN);
+        for (size_t i = 0; i < n; ++i, ++it) {
+            if (!comp_(it->first, price)) {
+                return it;
+            }
+        }
+        return std::lower_bound(it, end(), price,
+                                [this](const auto& lvl, int64_t p) { return comp_(lvl.first, p); });
+    }
+
+    iterator find(int64_t price) {
+        auto it = lower_bound(price);
+        return it != end() && it->first == price ? it : end();
+    }
+
+    const_iterator find(int64_t price) const { return const_cast<SortedLevels*>(this)->find(price); }
+
+    std::pair<iterator, bool> try_emplace(int64_t price) {
+        auto it = lower_bound(price);
+        if (it != end() && it->first == price) {
+            return { it, false };
+        }
+        auto pos = v_.emplace(it.base(), price, Level{});
+        return { std::make_reverse_iterator(std::next(pos)), true };
+    }
+
+    void erase(iterator it) { v_.erase(std::next(it).base()); }
+};
+
+struct SortedVectorLevels {
+    template <typename Level, typename Compare>
+    using type = SortedLevels<Level, Compare>;
+};
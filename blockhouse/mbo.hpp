@@ -0,0 +1,275 @@
+// mbo.hpp
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#include "csv_scan.hpp"
+#include "timestamp.hpp"
+
+static constexpr int64_t PRICE_UNDEF = std::numeric_limits<int64_t>::max();
+static constexpr double PRICE_SCALE = 1e9;
+static constexpr int PRICE_DECIMALS = 9;
+
+enum class Action : char { A='A', M='M', C='C', R='R', T='T', F='F', N='N' };
+enum class Side   : char { B='B', A='A', N='N' };
+
+struct PriceLevel {
+    int64_t price;
+    uint32_t size;
+    uint32_t count;
+};
+
+// A book's visible levels: depth bids best-first, then depth offers
+// best-first. Missing levels are PRICE_UNDEF with zero size and count.
+struct LevelsView {
+    const PriceLevel* data;
+    size_t depth;
+
+    size_t size() const { return 2 * depth; }
+    const PriceLevel& operator[](size_t i) const { return data[i]; }
+};
+
+// Inline, fixed-capacity text field so a parsed message owns its bytes
+// without touching the heap.
+template <size_t N>
+struct FixedString {
+    char    data[N];
+    uint8_t len{};
+
+    static_assert(N <= std::numeric_limits<uint8_t>::max());
+
+    bool assign(std::string_view s) {
+        if (s.size() > N) {
+            return false;
+        }
+        std::memcpy(data, s.data(), s.size());
+        len = static_cast<uint8_t>(s.size());
+        return true;
+    }
+
+    std::string_view view() const { return { data, len }; }
+};
+
+// DBN caps symbols at 71 bytes.
+static constexpr size_t SYMBOL_LEN = 71;
+
+namespace mbo_detail {
+
+// Splits a line at its first Commas commas in one scan. The field after
+// the last of them runs to the next comma or the end of the line.
+template <size_t Commas>
+class FieldCursor {
+    const char* p_;
+    size_t n_;
+    size_t found_;
+    size_t i_ = 0;
+    uint32_t commas_[Commas];
+
+public:
+    FieldCursor(const char* first, const char* last)
+        : p_(first), n_(static_cast<size_t>(last - first)), found_(csv_scan::find(first, n_, ',', commas_, Commas)) {}
+
+    bool next(std::string_view& field) {
+        if (i_ > found_) {
+            return false;
+        }
+        size_t b = i_ ? commas_[i_ - 1] + 1 : 0;
+        size_t e = i_ < found_ ? commas_[i_] : n_;
+        field = { p_ + b, e - b };
+        ++i_;
+        return true;
+    }
+};
+
+// before: bytes ahead of f that may be read (see csv_scan::parse_digits).
+template <typename T>
+inline bool parse_int(std::string_view f, T& out, size_t before = 0) {
+    // Plain digits take the word-at-a-time path; signs, overflowing
+    // lengths and errors go through from_chars.
+    if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(uint64_t)) {
+        uint64_t v;
+        if (csv_scan::parse_digits(f.data(), f.size(), v, before)) {
+            if (v > static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max())) {
+                return false;
+            }
+            out = static_cast<T>(v);
+            return true;
+        }
+    }
+    auto [ptr, ec] = std::from_chars(f.data(), f.data() + f.size(), out);
+    return ec == std::errc() && ptr == f.data() + f.size() && !f.empty();
+}
+
+inline bool parse_char(std::string_view f, char& out) {
+    if (f.size() != 1) {
+        return false;
+    }
+    out = f[0];
+    return true;
+}
+
+// Decimal text to fixed-point with PRICE_DECIMALS fractional digits.
+// Extra fractional digits are truncated, matching the old
+// static_cast<int64_t>(stold(field) * PRICE_SCALE) rounding direction.
+inline bool parse_price(std::string_view f, int64_t& out, size_t before = 0) {
+    static constexpr int64_t POW10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+    if (f.empty()) {
+        out = PRICE_UNDEF;
+        return true;
+    }
+    const char* p = f.data();
+    const char* end = p + f.size();
+    bool neg = false;
+    if (*p == '-') {
+        neg = true;
+        ++p;
+    }
+    static constexpr uint64_t MAX_WHOLE = std::numeric_limits<int64_t>::max() / POW10[PRICE_DECIMALS] - 1;
+    // Usual shape: digits, '.', at most PRICE_DECIMALS digits.
+    auto dot = static_cast<const char*>(std::memchr(p, '.', end - p));
+    size_t frac_len = dot ? static_cast<size_t>(end - dot - 1) : 0;
+    uint64_t w = 0, fr = 0;
+    before += static_cast<size_t>(p - f.data());
+    if (csv_scan::parse_digits(p, static_cast<size_t>((dot ? dot : end) - p), w, before) && w <= MAX_WHOLE &&
+        frac_len <= PRICE_DECIMALS &&
+        (frac_len == 0 || csv_scan::parse_digits(dot + 1, frac_len, fr, before + static_cast<size_t>(dot + 1 - p)))) {
+        int64_t v = static_cast<int64_t>(w) * POW10[PRICE_DECIMALS] + static_cast<int64_t>(fr) * POW10[PRICE_DECIMALS - frac_len];
+        out = neg ? -v : v;
+        return true;
+    }
+    // from_chars would take a second sign.
+    if (p != end && *p == '-') {
+        return false;
+    }
+    // An empty whole part before the dot is 0, as in ".48", but a bare
+    // "." has no digits at all.
+    int64_t whole = 0;
+    const char* ip = p;
+    if (p == end || *p != '.') {
+        auto [q, ec] = std::from_chars(p, end, whole);
+        if (ec != std::errc() || whole > std::numeric_limits<int64_t>::max() / POW10[PRICE_DECIMALS] - 1) {
+            return false;
+        }
+        ip = q;
+    } else if (end - p < 2) {
+        return false;
+    }
+    int64_t frac = 0;
+    int digits = 0;
+    if (ip != end) {
+        if (*ip != '.') {
+            return false;
+        }
+        for (++ip; ip != end; ++ip) {
+            unsigned d = static_cast<unsigned char>(*ip) - '0';
+            if (d > 9) {
+                return false;
+            }
+            if (digits < PRICE_DECIMALS) {
+                frac = frac * 10 + d;
+                ++digits;
+            }
+        }
+    }
+    int64_t v = whole * POW10[PRICE_DECIMALS] + frac * POW10[PRICE_DECIMALS - digits];
+    out = neg ? -v : v;
+    return true;
+}
+
+} // namespace mbo_detail
+
+struct MboMessage {
+    // Nanoseconds since the UNIX epoch.
+    uint64_t   ts_recv{};
+    uint64_t   ts_event{};
+    uint8_t    rtype{};
+    uint16_t   publisher_id{};
+    uint32_t   instrument_id{};
+    Action     action{};
+    Side       side{};
+    int        depth{};
+    int64_t    price{};
+    uint32_t   size{};
+    uint8_t    flags{};
+    int32_t    ts_in_delta{};
+    uint32_t   sequence{};
+    FixedString<SYMBOL_LEN> symbol;
+    uint64_t   order_id{};
+
+    // Also the commas to find: the last field ends at the next one.
+    static constexpr size_t FIELDS = 16;
+
+    // Field layout: ts_recv,ts_event,rtype,publisher_id,instrument_id,action,
+    // side,depth,price,size,order_id,flags,ts_in_delta,sequence,symbol,order_id
+    static std::optional<MboMessage> parse(std::string_view line) {
+        using namespace mbo_detail;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        FieldCursor<FIELDS> cur(line.data(), line.data() + line.size());
+        MboMessage m;
+        std::string_view f;
+        char c;
+        // The digit parser may read, and mask off, bytes earlier in the line.
+        auto num = [&](auto& out) { return parse_int(f, out, static_cast<size_t>(f.data() - line.data())); };
+
+        if (!cur.next(f) || !parse_timestamp(f, m.ts_recv)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !parse_timestamp(f, m.ts_event)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.rtype)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.publisher_id)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.instrument_id)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !parse_char(f, c)) {
+            return std::nullopt;
+        }
+        m.action = static_cast<Action>(c);
+        if (!cur.next(f) || !parse_char(f, c)) {
+            return std::nullopt;
+        }
+        m.side = static_cast<Side>(c);
+        if (!cur.next(f) || !num(m.depth)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !parse_price(f, m.price, static_cast<size_t>(f.data() - line.data()))) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.size)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.order_id)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.flags)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.ts_in_delta)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.sequence)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !m.symbol.assign(f)) {
+            return std::nullopt;
+        }
+        if (!cur.next(f) || !num(m.order_id)) {
+            return std::nullopt;
+        }
+        return m;
+    }
+};
@@ -0,0 +1,164 @@
+// mbp_sink.hpp
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "dbn.hpp"
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+#include "price_format.hpp"
+#include "timestamp.hpp"
+
+// Destination for reconstructed MBP rows.
+class MbpSink {
+public:
+    virtual ~MbpSink() = default;
+    virtual void write_row(uint32_t book, const MboMessage& m, LevelsView levels) = 0;
+    // Hands buffered rows to the OS now; false if a write failed. Sinks
+    // that can only write whole batches keep them until finish().
+    virtual bool flush() { return true; }
+    // Flushes everything; false if any write failed.
+    virtual bool finish() = 0;
+};
+
+class CsvSink : public MbpSink {
+    OutputBuffer out_;
+    MbpWriterSet writers_;
+
+public:
+    explicit CsvSink(int fd = 1, const PricePrecision* precision = nullptr) : out_(fd), writers_(out_, precision) {}
+
+    void write_row(uint32_t book, const MboMessage& m, LevelsView levels) override {
+        writers_[book].write_row(m, levels);
+    }
+
+    bool flush() override { return out_.flush(); }
+    bool finish() override { return out_.flush(); }
+};
+
+// Fixed-width DBN MBP-10 records behind a minimal DBN v2 metadata block
+// (no symbology), readable by DBN tooling and DbnReader-style decoders.
+// Books shallower than 10 levels leave the rest undefined; deeper ones
+// are cut at 10.
+class DbnSink : public MbpSink {
+    OutputBuffer out_;
+
+    void write_metadata() {
+        char* p = out_.reserve(8 + DBN_EMPTY_METADATA_LEN);
+        out_.commit(encode_dbn_metadata(p, DBN_SCHEMA_MBP10));
+    }
+
+public:
+    explicit DbnSink(int fd = 1) : out_(fd) { write_metadata(); }
+
+    void write_row(uint32_t, const MboMessage& m, LevelsView levels) override {
+        DbnMbp10Record r{};
+        r.hd = { sizeof(DbnMbp10Record) / 4, DBN_RTYPE_MBP10, m.publisher_id, m.instrument_id, m.ts_event };
+        r.price = m.price;
+        r.size = m.size;
+        r.action = static_cast<char>(m.action);
+        r.side = static_cast<char>(m.side);
+        r.flags = m.flags;
+        r.depth = static_cast<uint8_t>(m.depth);
+        r.ts_recv = m.ts_recv;
+        r.ts_in_delta = m.ts_in_delta;
+        r.sequence = m.sequence;
+        for (size_t i = 0; i < DBN_MBP_LEVELS; ++i) {
+            const PriceLevel& bid = i < levels.depth ? levels[i] : PriceLevel{ PRICE_UNDEF, 0, 0 };
+            const PriceLevel& ask = i < levels.depth ? levels[levels.depth + i] : PriceLevel{ PRICE_UNDEF, 0, 0 };
+            r.levels[i] = { bid.price, ask.price, bid.size, ask.size, bid.count, ask.count };
+        }
+        out_.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+
+    bool flush() override { return out_.flush(); }
+    bool finish() override { return out_.flush(); }
+};
+
+// Compact level-delta stream for consumers that keep their own book: one
+// line per visible level that changed,
+//   ts_recv,publisher_id,instrument_id,sequence,side,level,price,size,count
+// where side is B or A and level counts from 0 at the best price. An
+// emptied level has an empty price and zero size and count.
+class DeltaSink : public MbpSink {
+    static constexpr size_t MAX_LINE_LEN = ISO8601_NS_LEN + 80;
+
+    struct Book {
+        std::vector<PriceLevel> last;
+        PriceText prices;
+    };
+
+    OutputBuffer out_;
+    const PricePrecision* precision_;
+    Iso8601Writer ts_;
+    std::vector<Book> books_;
+
+public:
+    explicit DeltaSink(int fd = 1, const PricePrecision* precision = nullptr) : out_(fd), precision_(precision) {}
+
+    void write_row(uint32_t book, const MboMessage& m, LevelsView levels) override {
+        using namespace mbp_detail;
+        if (books_.size() <= book) {
+            books_.resize(book + 1);
+        }
+        auto& b = books_[book];
+        if (b.last.empty() && precision_) {
+            b.prices = PriceText(precision_->decimals(m.instrument_id));
+        }
+        auto& last = b.last;
+        last.resize(levels.size(), PriceLevel{ PRICE_UNDEF, 0, 0 });
+        for (size_t i = 0; i < levels.size(); ++i) {
+            const PriceLevel& l = levels[i];
+            PriceLevel& prev = last[i];
+            if (l.price == prev.price && l.size == prev.size && l.count == prev.count) {
+                continue;
+            }
+            prev = l;
+            char* q = out_.reserve(MAX_LINE_LEN);
+            q = ts_.write(q, m.ts_recv);
+            *q++ = ',';
+            q = put_int(q, m.publisher_id);
+            *q++ = ',';
+            q = put_int(q, m.instrument_id);
+            *q++ = ',';
+            q = put_int(q, m.sequence);
+            *q++ = ',';
+            *q++ = i < levels.depth ? 'B' : 'A';
+            *q++ = ',';
+            q = put_int(q, i % levels.depth);
+            *q++ = ',';
+            q = b.prices.put(q, l.price);
+            *q++ = ',';
+            q = put_int(q, l.size);
+            *q++ = ',';
+            q = put_int(q, l.count);
+            *q++ = '\n';
+            out_.commit(q);
+        }
+    }
+
+    bool flush() override { return out_.flush(); }
+    bool finish() override { return out_.flush(); }
+};
+
+enum class OutputFormat { Csv, Dbn, Deltas, Arrow, Parquet };
+
+inline bool parse_output_format(std::string_view s, OutputFormat& f) {
+    if (s == "csv") {
+        f = OutputFormat::Csv;
+    } else if (s == "dbn") {
+        f = OutputFormat::Dbn;
+    } else if (s == "deltas") {
+        f = OutputFormat::Deltas;
+    } else if (s == "arrow") {
+        f = OutputFormat::Arrow;
+    } else if (s == "parquet") {
+        f = OutputFormat::Parquet;
+    } else {
+        return false;
+    }
+    return true;
+}
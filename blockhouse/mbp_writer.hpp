@@ -0,0 +1,265 @@
+// mbp_writer.hpp
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "instrument.hpp"
+#include "mbo.hpp"
+#include "price_format.hpp"
+#include "timestamp.hpp"
+
+// Accumulates output in one large buffer and hands it to the OS in big
+// write() calls. Buffers that share a descriptor across threads pass a
+// mutex; each flush then lands as one uninterrupted run of whole rows.
+class OutputBuffer {
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+public:
+    // In place of a descriptor: keep everything, growing instead of
+    // flushing, for the owner to take with contents().
+    static constexpr int IN_MEMORY = -1;
+
+private:
+    int fd_;
+    std::mutex* fd_lock_ = nullptr;
+    std::vector<char> buf_;
+    size_t len_ = 0;
+    bool failed_ = false;
+
+    bool write_all(const char* p, size_t left) {
+        while (left) {
+#if defined(_WIN32)
+            auto n = ::_write(fd_, p, static_cast<unsigned>(left));
+#else
+            auto n = ::write(fd_, p, left);
+#endif
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+public:
+    explicit OutputBuffer(int fd = 1, size_t capacity = DEFAULT_CAPACITY)
+        : fd_(fd), buf_(capacity) {}
+
+    OutputBuffer(int fd, std::mutex& fd_lock, size_t capacity = DEFAULT_CAPACITY)
+        : fd_(fd), fd_lock_(&fd_lock), buf_(capacity) {}
+
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    // Returns room for at least n bytes; commit() what was actually used.
+    char* reserve(size_t n) {
+        if (buf_.size() - len_ < n) {
+            if (fd_ == IN_MEMORY) {
+                buf_.resize(std::max(2 * buf_.size(), len_ + n));
+            } else {
+                flush();
+                if (buf_.size() < n) {
+                    buf_.resize(n);
+                }
+            }
+        }
+        return buf_.data() + len_;
+    }
+
+    void commit(char* end) { len_ = static_cast<size_t>(end - buf_.data()); }
+
+    void append(const char* p, size_t n) {
+        char* out = reserve(n);
+        std::memcpy(out, p, n);
+        len_ += n;
+    }
+
+    void append(std::string_view s) { append(s.data(), s.size()); }
+
+    // Everything written since the last clear(), for IN_MEMORY buffers.
+    std::string_view contents() const { return { buf_.data(), len_ }; }
+
+    // Drops the contents, keeping the allocation.
+    void clear() { len_ = 0; }
+
+    // False if this or any earlier flush failed to write everything.
+    bool flush() {
+        if (fd_ == IN_MEMORY) {
+            return true;
+        }
+        size_t len = len_;
+        len_ = 0;
+        if (len && !failed_) {
+            if (fd_lock_) {
+                std::lock_guard<std::mutex> guard(*fd_lock_);
+                failed_ = !write_all(buf_.data(), len);
+            } else {
+                failed_ = !write_all(buf_.data(), len);
+            }
+            if (!failed_) {
+                instrument::count_bytes(len);
+            }
+        }
+        return !failed_;
+    }
+};
+
+namespace mbp_detail {
+
+template <typename T>
+inline char* put_int(char* out, T v) {
+    return std::to_chars(out, out + 24, v).ptr;
+}
+
+// Fixed-point price with PRICE_DECIMALS digits, e.g. 5510000000 -> 5.510000000.
+// PRICE_UNDEF prints as an empty field.
+inline char* put_price(char* out, int64_t price) {
+    return format_price(out, price);
+}
+
+} // namespace mbp_detail
+
+// Formats MBP rows into an OutputBuffer. The rtype column carries the
+// depth (10 for MBP-10, 1 for MBP-1). Each book slot remembers the bytes
+// it produced last row, so unchanged levels are a memcpy.
+class MbpWriter {
+    struct CachedLevel {
+        PriceLevel level{ PRICE_UNDEF, 0, 0 };
+        uint8_t len = 0;
+        bool valid = false;
+        char text[47];
+    };
+
+    // ",<price>,<size>,<count>" with every field at its widest.
+    static constexpr size_t MAX_LEVEL_LEN = 1 + 21 + 1 + 10 + 1 + 10;
+    static constexpr size_t MAX_HEADER_LEN = 2 * ISO8601_NS_LEN + SYMBOL_LEN + 160;
+    static_assert(MAX_LEVEL_LEN <= sizeof(CachedLevel::text));
+
+    OutputBuffer& out_;
+    const PricePrecision* precision_;
+    Iso8601Writer ts_;
+    uint32_t instrument_ = 0;
+    int decimals_ = -1;
+    PriceText prices_;
+    std::vector<CachedLevel> cache_;
+
+    // A writer serves one book, but a reused one may meet another
+    // instrument; text cached at other precision is dropped.
+    void select(uint32_t instrument_id) {
+        instrument_ = instrument_id;
+        int decimals = precision_ ? precision_->decimals(instrument_id) : PRICE_DECIMALS;
+        if (decimals != decimals_) {
+            decimals_ = decimals;
+            prices_ = PriceText(decimals);
+            for (auto& c : cache_) {
+                c.valid = false;
+            }
+        }
+    }
+
+    size_t format_level(char* out, const PriceLevel& p) {
+        char* q = out;
+        *q++ = ',';
+        q = prices_.put(q, p.price);
+        *q++ = ',';
+        q = mbp_detail::put_int(q, p.size);
+        *q++ = ',';
+        q = mbp_detail::put_int(q, p.count);
+        return static_cast<size_t>(q - out);
+    }
+
+public:
+    // Prices print at precision's digits for the row's instrument, or all
+    // PRICE_DECIMALS without one.
+    explicit MbpWriter(OutputBuffer& out, const PricePrecision* precision = nullptr)
+        : out_(out), precision_(precision) {}
+
+    void write_row(const MboMessage& m, LevelsView snap) {
+        using namespace mbp_detail;
+        if (decimals_ < 0 || m.instrument_id != instrument_) {
+            select(m.instrument_id);
+        }
+        if (cache_.size() < snap.size()) {
+            cache_.resize(snap.size());
+        }
+        char* q = out_.reserve(MAX_HEADER_LEN + snap.size() * MAX_LEVEL_LEN);
+        auto put = [&](std::string_view s) {
+            std::memcpy(q, s.data(), s.size());
+            q += s.size();
+        };
+        q = ts_.write(q, m.ts_recv);
+        *q++ = ',';
+        q = ts_.write(q, m.ts_event);
+        *q++ = ',';
+        q = put_int(q, snap.depth);
+        *q++ = ',';
+        q = put_int(q, m.publisher_id);
+        *q++ = ',';
+        q = put_int(q, m.instrument_id);
+        *q++ = ',';
+        *q++ = static_cast<char>(m.action);
+        *q++ = ',';
+        *q++ = static_cast<char>(m.side);
+        *q++ = ',';
+        q = put_int(q, m.depth);
+        *q++ = ',';
+        q = prices_.put(q, m.price);
+        *q++ = ',';
+        q = put_int(q, m.size);
+        *q++ = ',';
+        q = put_int(q, static_cast<int>(m.flags));
+        *q++ = ',';
+        q = put_int(q, m.ts_in_delta);
+        *q++ = ',';
+        q = put_int(q, m.sequence);
+        for (size_t i = 0; i < snap.size(); ++i) {
+            auto& c = cache_[i];
+            const auto& p = snap[i];
+            if (!c.valid || c.level.price != p.price || c.level.size != p.size || c.level.count != p.count) {
+                c.level = p;
+                c.len = static_cast<uint8_t>(format_level(c.text, p));
+                c.valid = true;
+            }
+            std::memcpy(q, c.text, c.len);
+            q += c.len;
+        }
+        *q++ = ',';
+        put(m.symbol.view());
+        *q++ = ',';
+        q = put_int(q, m.order_id);
+        *q++ = '\n';
+        out_.commit(q);
+    }
+};
+
+// One MbpWriter per book id, all feeding the same buffer.
+class MbpWriterSet {
+    OutputBuffer& out_;
+    const PricePrecision* precision_;
+    std::vector<MbpWriter> writers_;
+
+public:
+    explicit MbpWriterSet(OutputBuffer& out, const PricePrecision* precision = nullptr)
+        : out_(out), precision_(precision) {}
+
+    MbpWriter& operator[](size_t id) {
+        while (writers_.size() <= id) {
+            writers_.emplace_back(out_, precision_);
+        }
+        return writers_[id];
+    }
+};
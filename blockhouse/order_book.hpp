@@ -0,0 +1,494 @@
+// order_book.hpp
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+
+#include "depth_ladder.hpp"
+#include "instrument.hpp"
+#include "level_store.hpp"
+#include "mbo.hpp"
+#include "order_index.hpp"
+#include "pool.hpp"
+
+static constexpr uint8_t F_TOB = 1u << 6;
+// Default visible depth; reconstruct also builds 1 (BBO), 5 and 50.
+static constexpr size_t BOOK_DEPTH = 10;
+
+// Where a resting order stands in its level's time priority.
+struct QueuePosition {
+    Side side;
+    int64_t price;
+    uint32_t size;
+    // Orders ahead of it, and their total size.
+    uint32_t orders_ahead;
+    uint32_t size_ahead;
+};
+
+// Each level keeps its aggregate size and count up to date, and the book
+// keeps the visible top Depth levels per side cached. A change only
+// touches the cache when it lands inside the visible depth, and the slots
+// it actually changed are recorded for delta consumers. Storage picks
+// the per-side level container (see level_store.hpp).
+template <typename Storage, size_t Depth = BOOK_DEPTH>
+class BasicOrderBook {
+    // Compact resting order drawn from the pool. Orders are linked in time
+    // priority within their level, so unlinking or requeueing one never
+    // scans the level; price locates the level itself.
+    struct Order {
+        uint64_t order_id;
+        int64_t  price;
+        uint32_t size;
+        Side     side;
+        uint8_t  flags;
+        Order*   prev;
+        Order*   next;
+    };
+
+    struct Level {
+        uint32_t size = 0;
+        uint32_t count = 0;
+        Order* head = nullptr;
+        Order* tail = nullptr;
+
+        void push_back(Order& o) {
+            o.prev = tail;
+            o.next = nullptr;
+            (tail ? tail->next : head) = &o;
+            tail = &o;
+            size += o.size;
+            ++count;
+        }
+
+        void unlink(Order& o) {
+            (o.prev ? o.prev->next : head) = o.next;
+            (o.next ? o.next->prev : tail) = o.prev;
+            o.prev = o.next = nullptr;
+            size -= o.size;
+            --count;
+        }
+    };
+
+    static constexpr PriceLevel EMPTY_LEVEL{ PRICE_UNDEF, 0, 0 };
+
+    // Both sides iterate best price first.
+    using Bids = typename Storage::template type<Level, std::greater<int64_t>>;
+    using Offers = typename Storage::template type<Level, std::less<int64_t>>;
+
+    ObjectPool<Order> pool_;
+    OrderIndex<Order> orders_;
+    Bids bids_;
+    Offers offers_;
+    // Bids in [0, Depth), offers in [Depth, 2 * Depth).
+    std::array<PriceLevel, 2 * Depth> top_ = make_empty();
+    std::bitset<2 * Depth> changed_;
+    // Cancels and modifies naming an order the book does not hold.
+    uint64_t unknown_ = 0;
+    // Bids, then offers; off unless index_depth() turned them on.
+    std::array<DepthLadder, 2> ladders_;
+
+    static constexpr std::array<PriceLevel, 2 * Depth> make_empty() {
+        std::array<PriceLevel, 2 * Depth> a{};
+        for (auto& l : a) {
+            l = EMPTY_LEVEL;
+        }
+        return a;
+    }
+
+    void set_level(size_t i, const PriceLevel& l) {
+        PriceLevel& t = top_[i];
+        if (t.price != l.price || t.size != l.size || t.count != l.count) {
+            t = l;
+            changed_.set(i);
+        }
+    }
+
+    template <typename F>
+    void with_side(Side side, F&& f) {
+        if (side == Side::B) {
+            f(bids_, 0);
+        } else {
+            f(offers_, Depth);
+        }
+    }
+
+    template <typename F>
+    void with_side(Side side, F&& f) const {
+        if (side == Side::B) {
+            f(bids_, 0);
+        } else {
+            f(offers_, Depth);
+        }
+    }
+
+    // A level's size changed by size and its order count by orders.
+    void ladder_add(size_t base, int64_t price, int64_t size, int64_t orders) {
+        DepthLadder& l = ladders_[base != 0];
+        if (l.enabled()) {
+            l.add(price, size, orders);
+        }
+    }
+
+    template <typename Levels>
+    void refresh(const Levels& lvls, size_t base) {
+        size_t i = base;
+        for (auto it = lvls.begin(); it != lvls.end() && i < base + Depth; ++it, ++i) {
+            set_level(i, { it->first, it->second.size, it->second.count });
+        }
+        for (; i < base + Depth; ++i) {
+            set_level(i, EMPTY_LEVEL);
+        }
+    }
+
+    // Must be called against the cache as it was before the change.
+    template <typename Levels>
+    bool visible(const Levels& lvls, size_t base, int64_t price) const {
+        const PriceLevel& last = top_[base + Depth - 1];
+        return last.price == PRICE_UNDEF || !lvls.key_comp()(last.price, price);
+    }
+
+    // lvl is null when a level was created or erased, which shifts the
+    // visible levels behind it.
+    template <typename Levels>
+    void level_changed(const Levels& lvls, size_t base, int64_t price, const Level* lvl) {
+        if (!visible(lvls, base, price)) {
+            return;
+        }
+        if (!lvl) {
+            refresh(lvls, base);
+            return;
+        }
+        for (size_t i = base; i < base + Depth; ++i) {
+            if (top_[i].price == price) {
+                set_level(i, { price, lvl->size, lvl->count });
+                return;
+            }
+        }
+    }
+
+    template <typename Levels>
+    void index_side(const Levels& lvls, size_t base, int64_t tick, size_t ticks) {
+        DepthLadder& l = ladders_[base != 0];
+        l.enable(tick, ticks);
+        if (l.enabled()) {
+            for (const auto& [price, lvl] : lvls) {
+                l.add(price, lvl.size, lvl.count);
+            }
+        }
+    }
+
+    template <typename Levels>
+    void insert(Levels& lvls, size_t base, Order& o) {
+        auto [it, created] = lvls.try_emplace(o.price);
+        it->second.push_back(o);
+        ladder_add(base, o.price, o.size, 1);
+        level_changed(lvls, base, o.price, created ? nullptr : &it->second);
+    }
+
+    template <typename Levels>
+    void remove(Levels& lvls, size_t base, Order& o) {
+        auto it = lvls.find(o.price);
+        if (it == lvls.end()) {
+            return;
+        }
+        Level& l = it->second;
+        l.unlink(o);
+        ladder_add(base, o.price, -static_cast<int64_t>(o.size), -1);
+        if (!l.head) {
+            lvls.erase(it);
+            level_changed(lvls, base, o.price, nullptr);
+        } else {
+            level_changed(lvls, base, o.price, &l);
+        }
+    }
+
+    // Changes an order's size in place, keeping its queue position.
+    template <typename Levels>
+    void resize(Levels& lvls, size_t base, Order& o, uint32_t size) {
+        auto it = lvls.find(o.price);
+        if (it != lvls.end()) {
+            it->second.size -= o.size - size;
+            ladder_add(base, o.price, static_cast<int64_t>(size) - o.size, 0);
+        }
+        o.size = size;
+        if (it != lvls.end()) {
+            level_changed(lvls, base, o.price, &it->second);
+        }
+    }
+
+    void clear() {
+        orders_.clear();
+        pool_.reset();
+        bids_.clear();
+        offers_.clear();
+        for (DepthLadder& l : ladders_) {
+            l.clear();
+        }
+        for (size_t i = 0; i < top_.size(); ++i) {
+            set_level(i, EMPTY_LEVEL);
+        }
+    }
+
+    void release(Order* o) {
+        orders_.erase(o->order_id);
+        pool_.release(o);
+    }
+
+    // A top-of-book message replaces its whole side with one level that
+    // carries no individual orders.
+    void replace_side(const MboMessage& m) {
+        with_side(m.side, [&](auto& lvls, size_t base) {
+            for (auto& [price, lvl] : lvls) {
+                for (Order* o = lvl.head; o;) {
+                    Order* next = o->next;
+                    release(o);
+                    o = next;
+                }
+            }
+            lvls.clear();
+            lvls.try_emplace(m.price);
+            ladders_[base != 0].clear();
+            refresh(lvls, base);
+        });
+    }
+
+    void add(const MboMessage& m) {
+        if (m.flags & F_TOB) {
+            replace_side(m);
+            return;
+        }
+        Order* o = pool_.acquire();
+        *o = { m.order_id, m.price, m.size, m.side, m.flags, nullptr, nullptr };
+        if (!orders_.insert(m.order_id, o)) {
+            pool_.release(o);
+            return;
+        }
+        with_side(m.side, [&](auto& lvls, size_t base) { insert(lvls, base, *o); });
+    }
+
+    void cancel(const MboMessage& m) {
+        Order* o = orders_.find(m.order_id);
+        if (!o) {
+            ++unknown_;
+            return;
+        }
+        with_side(o->side, [&](auto& lvls, size_t base) {
+            if (o->size > m.size) {
+                resize(lvls, base, *o, o->size - m.size);
+            } else {
+                remove(lvls, base, *o);
+                release(o);
+            }
+        });
+    }
+
+    void modify(const MboMessage& m) {
+        Order* o = orders_.find(m.order_id);
+        if (!o) {
+            ++unknown_;
+            add(m);
+            return;
+        }
+        with_side(o->side, [&](auto& lvls, size_t base) {
+            if (o->price != m.price || o->size < m.size) {
+                // Loses queue priority: goes to the back of the new level.
+                remove(lvls, base, *o);
+                o->price = m.price;
+                o->size = m.size;
+                o->flags = m.flags;
+                insert(lvls, base, *o);
+            } else {
+                resize(lvls, base, *o, m.size);
+                o->flags = m.flags;
+            }
+        });
+    }
+
+public:
+    // Sizes the order index and pool for n resting orders.
+    void reserve(size_t n) {
+        orders_.reserve(n);
+        pool_.reserve(n);
+    }
+
+    // Empties the book, keeping its pool, index and cache allocations.
+    void reset() {
+        clear();
+        changed_.reset();
+        unknown_ = 0;
+    }
+
+    void apply(const MboMessage& m) {
+        instrument::Timer timer(instrument::apply_probe(m.action));
+        changed_.reset();
+        switch (m.action) {
+            case Action::R: clear(); break;
+            case Action::A: add(m);  break;
+            case Action::C: cancel(m); break;
+            case Action::M: modify(m); break;
+            default: break;
+        }
+    }
+
+    static constexpr size_t depth() { return Depth; }
+
+    size_t orders() const { return orders_.size(); }
+    size_t levels(Side side) const { return side == Side::B ? bids_.size() : offers_.size(); }
+    double index_load() const { return orders_.load_factor(); }
+    uint64_t unknown_orders() const { return unknown_; }
+
+    // Bids best-first, then offers best-first, Depth each; missing
+    // levels are PRICE_UNDEF with zero size and count.
+    const std::array<PriceLevel, 2 * Depth>& snapshot() const { return top_; }
+
+    LevelsView levels() const { return { top_.data(), Depth }; }
+
+    // Slots of snapshot() that the last apply() changed.
+    const std::bitset<2 * Depth>& changes() const { return changed_; }
+
+    // Full-depth queries on the live book, beyond the visible levels.
+
+    // Queue position of a resting order, or nullopt if the book does not
+    // hold it. Walks out from the order both ways at once and takes the
+    // side it did not finish from the level's totals, so the cost is the
+    // shorter of the runs ahead and behind.
+    std::optional<QueuePosition> queue_position(uint64_t order_id) const {
+        const Order* o = orders_.find(order_id);
+        if (!o) {
+            return std::nullopt;
+        }
+        QueuePosition q{ o->side, o->price, o->size, 0, 0 };
+        uint32_t behind = 0, behind_size = 0;
+        const Order* a = o->prev;
+        const Order* b = o->next;
+        for (; a && b; a = a->prev, b = b->next) {
+            ++q.orders_ahead;
+            q.size_ahead += a->size;
+            ++behind;
+            behind_size += b->size;
+        }
+        if (a) {
+            with_side(o->side, [&](const auto& lvls, size_t) {
+                const Level& l = lvls.find(o->price)->second;
+                q.orders_ahead = l.count - 1 - behind;
+                q.size_ahead = l.size - o->size - behind_size;
+            });
+        }
+        return q;
+    }
+
+    // The level at price, or zero size and count if there is none.
+    PriceLevel depth_at(Side side, int64_t price) const {
+        PriceLevel out{ price, 0, 0 };
+        with_side(side, [&](const auto& lvls, size_t) {
+            auto it = lvls.find(price);
+            if (it != lvls.end()) {
+                out.size = it->second.size;
+                out.count = it->second.count;
+            }
+        });
+        return out;
+    }
+
+    // Resting size and orders priced within distance of the side's best
+    // price, best included; distance is ticks * tick for the depth N ticks
+    // out, and a negative one gives nothing. The range stops at the ends
+    // of int64. Uses the ladder from index_depth() when it can answer,
+    // else walks the levels in range.
+    DepthSum depth_within(Side side, int64_t distance) const {
+        DepthSum out;
+        if (distance < 0) {
+            return out;
+        }
+        with_side(side, [&](const auto& lvls, size_t base) {
+            if (lvls.empty()) {
+                return;
+            }
+            constexpr int64_t MIN = std::numeric_limits<int64_t>::min();
+            constexpr int64_t MAX = std::numeric_limits<int64_t>::max();
+            int64_t best = lvls.begin()->first;
+            int64_t lo = best;
+            int64_t hi = best;
+            if (base) {
+                hi = best > MAX - distance ? MAX : best + distance;
+            } else {
+                lo = best < MIN + distance ? MIN : best - distance;
+            }
+            const DepthLadder& l = ladders_[base != 0];
+            if (l.enabled() && l.sum(lo, hi, out)) {
+                return;
+            }
+            out = {};
+            for (auto it = lvls.begin(); it != lvls.end() && it->first >= lo && it->first <= hi; ++it) {
+                out.size += it->second.size;
+                out.orders += it->second.count;
+            }
+        });
+        return out;
+    }
+
+    // Keeps a DepthLadder per side over ticks ticks of tick price units,
+    // so depth_within() takes O(log ticks) however many levels it spans.
+    // Each level change then costs two tree updates; tick 0 turns it off.
+    void index_depth(int64_t tick, size_t ticks) {
+        with_side(Side::B, [&](const auto& lvls, size_t base) { index_side(lvls, base, tick, ticks); });
+        with_side(Side::A, [&](const auto& lvls, size_t base) { index_side(lvls, base, tick, ticks); });
+    }
+
+    // Walks the resting state for a checkpoint: level(side, price, orders)
+    // for every level, bids then offers, best first, each followed by
+    // order(order_id, size, flags) for its orders in queue order.
+    template <typename L, typename O>
+    void save(L&& level, O&& order) const {
+        auto side = [&](const auto& lvls, Side s) {
+            for (const auto& [price, lvl] : lvls) {
+                level(s, price, lvl.count);
+                for (const Order* o = lvl.head; o; o = o->next) {
+                    order(o->order_id, o->size, o->flags);
+                }
+            }
+        };
+        side(bids_, Side::B);
+        side(offers_, Side::A);
+    }
+
+    // Rebuild from save()'s walk, in the same order, into an empty book:
+    // restore_level() for each level, then restore_order() for each of its
+    // orders, and restore_done() once at the end with the saved
+    // unknown_orders().
+    void restore_level(Side side, int64_t price) {
+        with_side(side, [&](auto& lvls, size_t) { lvls.try_emplace(price); });
+    }
+
+    bool restore_order(Side side, int64_t price, uint64_t order_id, uint32_t size, uint8_t flags) {
+        Order* o = pool_.acquire();
+        *o = { order_id, price, size, side, flags, nullptr, nullptr };
+        if (!orders_.insert(order_id, o)) {
+            pool_.release(o);
+            return false;
+        }
+        with_side(side, [&](auto& lvls, size_t base) {
+            lvls.find(price)->second.push_back(*o);
+            ladder_add(base, price, size, 1);
+        });
+        return true;
+    }
+
+    void restore_done(uint64_t unknown_orders) {
+        unknown_ = unknown_orders;
+        refresh(bids_, 0);
+        refresh(offers_, Depth);
+        changed_.reset();
+    }
+};
+
+#if defined(BLOCKHOUSE_SORTED_LEVELS)
+template <size_t Depth = BOOK_DEPTH>
+using OrderBook = BasicOrderBook<SortedVectorLevels, Depth>;
+#else
+template <size_t Depth = BOOK_DEPTH>
+using OrderBook = BasicOrderBook<MapLevels, Depth>;
+#endif
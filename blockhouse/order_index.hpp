@@ -0,0 +1,131 @@
+// order_index.hpp
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Open-addressing map from order_id to a pooled record, tuned for the
+// add/cancel churn of an MBO feed. Robin-hood probing keeps probe runs
+// short at high load, and deletion shifts the run back instead of
+// leaving tombstones, so long sessions never degrade. Size it up front
+// with reserve(); growth only happens if that hint was too small, and
+// clear() keeps the capacity for the next session.
+template <typename T>
+class OrderIndex {
+    struct Slot {
+        uint64_t key;
+        T* value;
+    };
+
+    static constexpr size_t MIN_CAPACITY = 1024;
+    // Maximum load factor as a fraction.
+    static constexpr size_t LOAD_NUM = 7;
+    static constexpr size_t LOAD_DEN = 8;
+
+    std::vector<Slot> slots_ = std::vector<Slot>(MIN_CAPACITY, Slot{ 0, nullptr });
+    size_t mask_ = MIN_CAPACITY - 1;
+    size_t size_ = 0;
+    size_t rehashes_ = 0;
+
+    size_t home(uint64_t key) const {
+        // Fibonacci hashing spreads the mostly sequential ids.
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+    }
+
+    size_t distance(size_t i, uint64_t key) const { return (i - home(key)) & mask_; }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old(capacity, Slot{ 0, nullptr });
+        old.swap(slots_);
+        mask_ = capacity - 1;
+        size_ = 0;
+        for (const Slot& s : old) {
+            if (s.value) {
+                insert(s.key, s.value);
+            }
+        }
+    }
+
+public:
+    // Sizes the table so n live orders fit without rehashing.
+    void reserve(size_t n) {
+        size_t want = MIN_CAPACITY;
+        while (want * LOAD_NUM < n * LOAD_DEN) {
+            want *= 2;
+        }
+        if (want > slots_.size()) {
+            rehash(want);
+        }
+    }
+
+    T* find(uint64_t key) const {
+        for (size_t i = home(key), d = 0;; i = (i + 1) & mask_, ++d) {
+            const Slot& s = slots_[i];
+            if (!s.value || distance(i, s.key) < d) {
+                return nullptr;
+            }
+            if (s.key == key) {
+                return s.value;
+            }
+        }
+    }
+
+    // Returns false, leaving the map unchanged, if key is already present.
+    bool insert(uint64_t key, T* value) {
+        if ((size_ + 1) * LOAD_DEN > slots_.size() * LOAD_NUM) {
+            ++rehashes_;
+            rehash(slots_.size() * 2);
+        }
+        Slot cur{ key, value };
+        bool displaced = false;
+        for (size_t i = home(key), d = 0;; i = (i + 1) & mask_, ++d) {
+            Slot& s = slots_[i];
+            if (!s.value) {
+                s = cur;
+                ++size_;
+                return true;
+            }
+            if (!displaced && s.key == key) {
+                return false;
+            }
+            size_t sd = distance(i, s.key);
+            if (sd < d) {
+                // Take from the rich: the resident is closer to home.
+                std::swap(cur, s);
+                d = sd;
+                displaced = true;
+            }
+        }
+    }
+
+    void erase(uint64_t key) {
+        size_t i = home(key);
+        for (size_t d = 0;; i = (i + 1) & mask_, ++d) {
+            const Slot& s = slots_[i];
+            if (!s.value || distance(i, s.key) < d) {
+                return;
+            }
+            if (s.key == key) {
+                break;
+            }
+        }
+        for (size_t j = (i + 1) & mask_; slots_[j].value && distance(j, slots_[j].key); j = (j + 1) & mask_) {
+            slots_[i] = slots_[j];
+            i = j;
+        }
+        slots_[i] = { 0, nullptr };
+        --size_;
+    }
+
+    void clear() {
+        std::fill(slots_.begin(), slots_.end(), Slot{ 0, nullptr });
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+    double load_factor() const { return static_cast<double>(size_) / static_cast<double>(slots_.size()); }
+    // Times the table outgrew its reservation.
+    size_t rehashes() const { return rehashes_; }
+};
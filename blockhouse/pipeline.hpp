@@ -0,0 +1,278 @@
+// pipeline.hpp
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "book_manager.hpp"
+#include "feed_stats.hpp"
+#include "input_source.hpp"
+#include "instrument.hpp"
+#include "mbo.hpp"
+#include "mbp_sink.hpp"
+#include "order_book.hpp"
+#include "spsc_ring.hpp"
+
+// Runs reconstruction as overlapping stages on separate threads:
+//
+//   reader -> parsers (N) -> apply (1) -> format/write (1)
+//
+// The reader cuts the input into line-aligned blocks and deals them to the
+// parsers round-robin. The apply thread drains the parsers in that same
+// order, so books see messages in file order. It sends each message on
+// with only the visible levels it changed, and the format thread patches
+// its copy of the levels before writing.
+// Every hop is an SPSC ring of batches, plus a ring that hands spent
+// batches back for reuse.
+template <size_t Depth = BOOK_DEPTH>
+class Pipeline {
+    static constexpr size_t BLOCK_BYTES = 1 << 20;
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr size_t RING_SLOTS = 8;
+    static constexpr size_t LEVELS = 2 * Depth;
+
+    struct Block {
+        std::string_view text;
+        // Backing store when the source reuses its chunk buffer.
+        std::vector<char> copy;
+    };
+
+    struct MessageBatch {
+        size_t n = 0;
+        bool end_of_block = false;
+        MboMessage msgs[BATCH_SIZE];
+    };
+
+    struct LevelDelta {
+        uint32_t slot;
+        PriceLevel level;
+    };
+
+    struct Row {
+        MboMessage msg;
+        uint32_t book;
+        uint32_t first_delta;
+        uint32_t deltas;
+    };
+
+    struct RowBatch {
+        size_t n = 0;
+        size_t deltas = 0;
+        Row rows[BATCH_SIZE];
+        LevelDelta delta[BATCH_SIZE * LEVELS];
+    };
+
+    template <typename T>
+    struct Channel {
+        std::unique_ptr<T[]> storage = std::make_unique<T[]>(RING_SLOTS);
+        SpscRing<T*, RING_SLOTS> full;
+        SpscRing<T*, RING_SLOTS> free;
+
+        Channel() {
+            for (size_t i = 0; i < RING_SLOTS; ++i) {
+                free.push(&storage[i]);
+            }
+        }
+    };
+
+    struct Parser {
+        Channel<Block> blocks;
+        Channel<MessageBatch> batches;
+        uint64_t bad_lines = 0;
+        std::thread thread;
+    };
+
+    InputSource& in_;
+    BookManager<Depth> books_;
+    MbpSink& sink_;
+    bool changed_only_;
+    std::vector<std::unique_ptr<Parser>> parsers_;
+    Channel<RowBatch> rows_;
+    bool ok_ = true;
+
+    void parse(Parser& p) {
+        MessageBatch* b = p.batches.free.pop();
+        while (Block* blk = p.blocks.full.pop()) {
+            const char* q = blk->text.data();
+            const char* end = q + blk->text.size();
+            while (q < end) {
+                auto nl = static_cast<const char*>(std::memchr(q, '\n', end - q));
+                if (!nl) {
+                    nl = end;
+                }
+                std::string_view line(q, static_cast<size_t>(nl - q));
+                std::optional<MboMessage> m;
+                {
+                    instrument::Timer timer(instrument::PARSE);
+                    m = MboMessage::parse(line);
+                }
+                if (m) {
+                    b->msgs[b->n++] = *m;
+                    if (b->n == BATCH_SIZE) {
+                        p.batches.full.push(b);
+                        b = p.batches.free.pop();
+                    }
+                } else if (!is_csv_header(line)) {
+                    ++p.bad_lines;
+                }
+                q = nl + 1;
+            }
+            b->end_of_block = true;
+            p.batches.full.push(b);
+            b = p.batches.free.pop();
+            p.blocks.free.push(blk);
+        }
+        p.batches.full.push(nullptr);
+    }
+
+    void apply() {
+        RowBatch* out = rows_.free.pop();
+        auto emit = [&](const auto& e, const MboMessage& m) {
+            const auto& changes = e.book.changes();
+            if (changed_only_ && changes.none()) {
+                return;
+            }
+            const auto& snap = e.book.snapshot();
+            Row& r = out->rows[out->n++];
+            r.msg = m;
+            r.book = e.id;
+            r.first_delta = static_cast<uint32_t>(out->deltas);
+            for (uint32_t i = 0; i < LEVELS; ++i) {
+                if (changes[i]) {
+                    out->delta[out->deltas++] = { i, snap[i] };
+                }
+            }
+            r.deltas = static_cast<uint32_t>(out->deltas - r.first_delta);
+            if (out->n == BATCH_SIZE) {
+                rows_.full.push(out);
+                out = rows_.free.pop();
+            }
+        };
+        size_t k = 0;
+        for (;; k = (k + 1) % parsers_.size()) {
+            Parser& p = *parsers_[k];
+            MessageBatch* b = p.batches.full.pop();
+            if (!b) {
+                break;
+            }
+            for (;;) {
+                for (size_t i = 0; i < b->n; ++i) {
+                    books_.process(b->msgs[i], emit);
+                }
+                bool last = b->end_of_block;
+                b->n = 0;
+                b->end_of_block = false;
+                p.batches.free.push(b);
+                if (last) {
+                    break;
+                }
+                b = p.batches.full.pop();
+            }
+        }
+        books_.finish(emit);
+        if (out->n) {
+            rows_.full.push(out);
+        }
+        rows_.full.push(nullptr);
+        // Every block has been consumed; the other parsers hold only their
+        // end markers.
+        for (size_t j = 0; j < parsers_.size(); ++j) {
+            if (j != k) {
+                parsers_[j]->batches.full.pop();
+            }
+        }
+    }
+
+    void format() {
+        std::vector<std::vector<PriceLevel>> views;
+        while (RowBatch* b = rows_.full.pop()) {
+            for (size_t i = 0; i < b->n; ++i) {
+                const Row& r = b->rows[i];
+                if (views.size() <= r.book) {
+                    views.resize(r.book + 1, std::vector<PriceLevel>(LEVELS, PriceLevel{ PRICE_UNDEF, 0, 0 }));
+                }
+                auto& view = views[r.book];
+                for (uint32_t d = r.first_delta; d < r.first_delta + r.deltas; ++d) {
+                    view[b->delta[d].slot] = b->delta[d].level;
+                }
+                instrument::Timer timer(instrument::WRITE);
+                sink_.write_row(r.book, r.msg, LevelsView{ view.data(), Depth });
+            }
+            b->n = 0;
+            b->deltas = 0;
+            rows_.free.push(b);
+        }
+        ok_ = sink_.finish();
+    }
+
+    void dispatch(Parser& p, std::string_view text, bool stable) {
+        Block* blk = p.blocks.free.pop();
+        if (stable) {
+            blk->text = text;
+        } else {
+            blk->copy.assign(text.begin(), text.end());
+            blk->text = { blk->copy.data(), blk->copy.size() };
+        }
+        p.blocks.full.push(blk);
+    }
+
+public:
+    Pipeline(InputSource& in, size_t parsers, size_t first_book_orders, MbpSink& sink,
+             bool changed_only = false)
+        : in_(in), books_(first_book_orders), sink_(sink), changed_only_(changed_only) {
+        for (size_t i = 0; i < std::max<size_t>(parsers, 1); ++i) {
+            parsers_.push_back(std::make_unique<Parser>());
+        }
+    }
+
+    // Reads the whole input on the calling thread; false if a write failed.
+    bool run() {
+        for (auto& p : parsers_) {
+            Parser* raw = p.get();
+            p->thread = std::thread([this, raw] { parse(*raw); });
+        }
+        std::thread applier([this] { apply(); });
+        std::thread formatter([this] { format(); });
+
+        size_t next = 0;
+        std::string_view chunk;
+        while (in_.next_chunk(chunk)) {
+            while (!chunk.empty()) {
+                size_t len = chunk.size();
+                if (len > BLOCK_BYTES) {
+                    auto nl = static_cast<const char*>(
+                        std::memchr(chunk.data() + BLOCK_BYTES, '\n', len - BLOCK_BYTES));
+                    len = nl ? static_cast<size_t>(nl - chunk.data()) + 1 : len;
+                }
+                dispatch(*parsers_[next], chunk.substr(0, len), in_.stable());
+                next = (next + 1) % parsers_.size();
+                chunk.remove_prefix(len);
+            }
+        }
+        for (auto& p : parsers_) {
+            p->blocks.full.push(nullptr);
+        }
+        for (auto& p : parsers_) {
+            p->thread.join();
+        }
+        applier.join();
+        formatter.join();
+        return ok_;
+    }
+
+    // The books as the run left them.
+    const BookManager<Depth>& books() const { return books_; }
+
+    // Lines that failed to parse, once run() has returned.
+    uint64_t bad_lines() const {
+        uint64_t n = 0;
+        for (const auto& p : parsers_) {
+            n += p->bad_lines;
+        }
+        return n;
+    }
+};
@@ -0,0 +1,65 @@
+// pool.hpp
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Slab allocator for small trivial records. Released slots go on an
+// intrusive free list and slabs are kept across reset(), so a warmed-up
+// pool never touches the heap.
+template <typename T, size_t SlabSize = 4096>
+class ObjectPool {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+    union Slot {
+        T value;
+        Slot* next;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    Slot* free_ = nullptr;
+    Slot* cur_ = nullptr;
+    size_t active_ = 0;
+    size_t used_ = SlabSize;
+
+public:
+    T* acquire() {
+        if (free_) {
+            Slot* s = free_;
+            free_ = s->next;
+            return &s->value;
+        }
+        if (used_ == SlabSize) {
+            if (active_ == slabs_.size()) {
+                slabs_.push_back(std::make_unique<Slot[]>(SlabSize));
+            }
+            cur_ = slabs_[active_++].get();
+            used_ = 0;
+        }
+        return &cur_[used_++].value;
+    }
+
+    void release(T* p) {
+        Slot* s = reinterpret_cast<Slot*>(p);
+        s->next = free_;
+        free_ = s;
+    }
+
+    // Preallocates slabs so n live records need no further allocation.
+    void reserve(size_t n) {
+        while (slabs_.size() * SlabSize < n) {
+            slabs_.push_back(std::make_unique<Slot[]>(SlabSize));
+        }
+    }
+
+    // Returns every slot to the pool without freeing the slabs.
+    void reset() {
+        free_ = nullptr;
+        cur_ = nullptr;
+        active_ = 0;
+        used_ = SlabSize;
+    }
+
+    size_t capacity() const { return slabs_.size() * SlabSize; }
+};
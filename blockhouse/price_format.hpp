@@ -0,0 +1,180 @@
+// price_format.hpp
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mbo.hpp"
+
+namespace price_detail {
+
+static constexpr uint64_t POW10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+    1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull,
+    10000000000000000000ull
+};
+
+static constexpr auto PAIRS = [] {
+    std::array<char, 200> a{};
+    for (size_t i = 0; i < 100; ++i) {
+        a[2 * i] = static_cast<char>('0' + i / 10);
+        a[2 * i + 1] = static_cast<char>('0' + i % 10);
+    }
+    return a;
+}();
+
+inline int count_digits(uint64_t v) {
+    int n = 1;
+    while (n < 20 && v >= POW10[n]) {
+        ++n;
+    }
+    return n;
+}
+
+// Exactly n digits of v, zero-padded, two at a time from the right.
+inline void put_digits(char* out, uint64_t v, int n) {
+    while (n >= 2) {
+        n -= 2;
+        std::memcpy(out + n, &PAIRS[2 * (v % 100)], 2);
+        v /= 100;
+    }
+    if (n) {
+        out[0] = static_cast<char>('0' + v % 10);
+    }
+}
+
+} // namespace price_detail
+
+// Fixed-point price with decimals fractional digits (0 to PRICE_DECIMALS),
+// e.g. 5510000000 at 2 -> 5.51. Digits the precision would drop are
+// printed in full rather than lost, so a price off the expected tick
+// still prints exactly. PRICE_UNDEF prints as an empty field.
+inline char* format_price(char* out, int64_t price, int decimals = PRICE_DECIMALS) {
+    using namespace price_detail;
+    if (price == PRICE_UNDEF) {
+        return out;
+    }
+    uint64_t v = static_cast<uint64_t>(price);
+    if (price < 0) {
+        *out++ = '-';
+        v = 0 - v;
+    }
+    uint64_t whole = v / POW10[PRICE_DECIMALS];
+    uint64_t frac = v % POW10[PRICE_DECIMALS];
+    if (frac % POW10[PRICE_DECIMALS - decimals] != 0) {
+        decimals = PRICE_DECIMALS;
+    }
+    int n = count_digits(whole);
+    put_digits(out, whole, n);
+    out += n;
+    if (decimals == 0) {
+        return out;
+    }
+    *out++ = '.';
+    put_digits(out, frac / POW10[PRICE_DECIMALS - decimals], decimals);
+    return out + decimals;
+}
+
+// Fractional digits to print per instrument; PRICE_DECIMALS unless set.
+class PricePrecision {
+    int default_ = PRICE_DECIMALS;
+    // Sorted by instrument_id.
+    std::vector<std::pair<uint32_t, int>> instruments_;
+
+    // "N" is a digit count, anything with a '.' a tick size.
+    static bool parse_decimals(std::string_view s, int& decimals) {
+        if (s.find('.') == std::string_view::npos) {
+            return mbo_detail::parse_int(s, decimals) && decimals >= 0 && decimals <= PRICE_DECIMALS;
+        }
+        int64_t tick = 0;
+        if (!mbo_detail::parse_price(s, tick) || tick <= 0 || tick == PRICE_UNDEF) {
+            return false;
+        }
+        decimals = PRICE_DECIMALS;
+        while (decimals > 0 && tick % 10 == 0) {
+            tick /= 10;
+            --decimals;
+        }
+        return true;
+    }
+
+public:
+    // Comma-separated entries, each DECIMALS or TICK to set the default,
+    // or INSTRUMENT_ID=DECIMALS or INSTRUMENT_ID=TICK for one instrument:
+    // "2,1108=4" or "0.01,1108=0.0005". False on a malformed entry.
+    bool parse(std::string_view spec) {
+        while (!spec.empty()) {
+            size_t comma = std::min(spec.find(','), spec.size());
+            std::string_view item = spec.substr(0, comma);
+            spec.remove_prefix(std::min(comma + 1, spec.size()));
+            size_t eq = item.find('=');
+            int decimals = 0;
+            if (eq == std::string_view::npos) {
+                if (!parse_decimals(item, decimals)) {
+                    return false;
+                }
+                default_ = decimals;
+                continue;
+            }
+            uint32_t id = 0;
+            if (!mbo_detail::parse_int(item.substr(0, eq), id) || !parse_decimals(item.substr(eq + 1), decimals)) {
+                return false;
+            }
+            auto it = std::lower_bound(instruments_.begin(), instruments_.end(), std::make_pair(id, 0));
+            if (it != instruments_.end() && it->first == id) {
+                it->second = decimals;
+            } else {
+                instruments_.insert(it, { id, decimals });
+            }
+        }
+        return true;
+    }
+
+    int decimals(uint32_t instrument_id) const {
+        auto it = std::lower_bound(instruments_.begin(), instruments_.end(), std::make_pair(instrument_id, 0));
+        return it != instruments_.end() && it->first == instrument_id ? it->second : default_;
+    }
+};
+
+// One instrument's price text, remembered for the prices seen most
+// recently. Levels near the touch recur constantly as the book moves, so
+// most lookups are a copy of text formatted earlier.
+class PriceText {
+    static constexpr size_t SLOTS = 256;
+    // Sign, 10 whole digits, point and 9 decimals, rounded up so the copy
+    // is a fixed-size move.
+    static constexpr size_t MAX_LEN = 24;
+
+    struct Slot {
+        int64_t price = PRICE_UNDEF;
+        uint8_t len = 0;
+        char text[MAX_LEN];
+    };
+
+    int decimals_ = PRICE_DECIMALS;
+    std::vector<Slot> slots_;
+
+public:
+    explicit PriceText(int decimals = PRICE_DECIMALS) : decimals_(decimals) {}
+
+    char* put(char* out, int64_t price) {
+        if (price == PRICE_UNDEF) {
+            return out;
+        }
+        if (slots_.empty()) {
+            slots_.resize(SLOTS);
+        }
+        Slot& s = slots_[(static_cast<uint64_t>(price) * 0x9E3779B97F4A7C15ull) >> 56];
+        if (s.price != price) {
+            s.price = price;
+            s.len = static_cast<uint8_t>(format_price(s.text, price, decimals_) - s.text);
+        }
+        std::memcpy(out, s.text, MAX_LEN);
+        return out + s.len;
+    }
+};
@@ -0,0 +1,78 @@
+// replay.hpp
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "histogram.hpp"
+#include "mbo.hpp"
+
+// Live-feed replay: holds each message back until its ts_recv comes due
+// (recorded gaps divided by speed; speed 0 feeds as fast as possible)
+// and times every output row from when its message was due. Falling
+// behind in a burst shows up in the tail, not just in the total runtime.
+class ReplayClock {
+    using Clock = std::chrono::steady_clock;
+
+    // Sleeps overshoot; the last stretch before a message is spun.
+    static constexpr int64_t SPIN_NS = 50000;
+
+    double speed_;
+    Clock::time_point start_ = Clock::now();
+    bool anchored_ = false;
+    uint64_t first_recv_ = 0;
+    int64_t first_due_ = 0;
+    int64_t due_ = 0;
+    int64_t max_behind_ = 0;
+    uint64_t messages_ = 0;
+    Histogram latency_;
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+    }
+
+public:
+    explicit ReplayClock(double speed) : speed_(speed) {}
+
+    // Waits until m is due, then counts it as arrived.
+    void arrive(const MboMessage& m) {
+        ++messages_;
+        int64_t t = now();
+        uint64_t recv = m.ts_recv;
+        if (speed_ <= 0) {
+            due_ = t;
+            return;
+        }
+        if (!anchored_) {
+            anchored_ = true;
+            first_recv_ = recv;
+            first_due_ = t;
+        }
+        int64_t due = first_due_;
+        if (recv > first_recv_) {
+            due += static_cast<int64_t>(static_cast<double>(recv - first_recv_) / speed_);
+        }
+        if (due - t > SPIN_NS) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - t - SPIN_NS));
+        }
+        while ((t = now()) < due) {
+        }
+        max_behind_ = t - due > max_behind_ ? t - due : max_behind_;
+        due_ = due;
+    }
+
+    // A row for the latest message has been handed to the sink.
+    void emitted() { latency_.record(static_cast<uint64_t>(now() - due_)); }
+
+    void report(std::FILE* out) const {
+        auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000; };
+        std::fprintf(out, "replay: %llu messages, %llu rows, max %.1f us behind schedule\n",
+                     static_cast<unsigned long long>(messages_),
+                     static_cast<unsigned long long>(latency_.count()), us(static_cast<uint64_t>(max_behind_)));
+        std::fprintf(out, "due->row us: mean %.2f p50 %.2f p90 %.2f p99 %.2f p99.9 %.2f p99.99 %.2f max %.2f\n",
+                     latency_.mean() / 1000, us(latency_.quantile(0.5)), us(latency_.quantile(0.9)),
+                     us(latency_.quantile(0.99)), us(latency_.quantile(0.999)), us(latency_.quantile(0.9999)),
+                     us(latency_.max()));
+    }
+};
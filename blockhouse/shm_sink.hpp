@@ -0,0 +1,320 @@
+// shm_sink.hpp
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "book_snapshot.hpp"
+#include "mbo.hpp"
+#include "mbp_sink.hpp"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BLOCKHOUSE_WITH_SHM 1
+#endif
+
+// Publishes the reconstructed books to a POSIX shared-memory segment, so
+// any number of processes can follow one reconstruction without copying.
+// The segment, all in host byte order, is
+//
+//   ShmHeader                         at 0
+//   BookSlot<depth>[book_capacity]    at books_offset
+//   Seqlock<ShmEvent>[event_capacity] at events_offset
+//
+// Book slots are indexed by book id, in order of first appearance; each
+// holds a book's key and its BookSnapshot behind a seqlock (see
+// book_snapshot.hpp). The event ring holds one ShmEvent per output row;
+// event n is in slot n % event_capacity, and the writer publishes it by
+// raising ShmHeader::events to n + 1 after storing it. A book slot is
+// updated before the events of its row, so a reader that sees an event
+// finds the book at that state or later. A sink sees only the visible
+// levels, so BookSnapshot::orders is 0 here.
+static constexpr uint64_t SHM_MAGIC = 0x314D4853484B4C42ull;  // "BLKHSHM1"
+static constexpr uint32_t SHM_VERSION = 1;
+static constexpr size_t SHM_BOOKS = 1024;
+static constexpr size_t SHM_EVENTS = 1 << 16;
+
+enum class ShmState : uint32_t { Starting = 0, Live = 1, Finished = 2 };
+
+struct alignas(64) ShmHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t depth;
+    uint32_t book_capacity;
+    uint32_t event_capacity;
+    uint64_t books_offset;
+    uint64_t events_offset;
+    uint64_t size;
+    // Slots below this may be in use; an unused one has version 0.
+    std::atomic<uint64_t> books;
+    // Events published so far.
+    std::atomic<uint64_t> events;
+    // ShmState; Live once the layout above is filled in.
+    std::atomic<uint32_t> state;
+};
+
+// One output row: the message as it went into the row, and its book.
+struct ShmEvent {
+    // Position in the event stream; a reader finding another number in
+    // the slot it expected was lapped by the writer.
+    uint64_t index;
+    uint64_t ts_recv;
+    uint64_t ts_event;
+    int64_t price;
+    uint64_t order_id;
+    uint32_t book;
+    uint32_t size;
+    uint32_t sequence;
+    int32_t ts_in_delta;
+    char action;
+    char side;
+    uint8_t flags;
+    uint8_t reserved[5];
+};
+
+static_assert(sizeof(ShmEvent) == 64);
+
+namespace shm_detail {
+
+inline size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+template <size_t Depth>
+struct Layout {
+    size_t books_offset = round_up(sizeof(ShmHeader), 64);
+    size_t events_offset;
+    size_t size;
+
+    Layout(size_t books, size_t events) {
+        events_offset = round_up(books_offset + books * sizeof(BookSlot<Depth>), 64);
+        size = events_offset + events * sizeof(Seqlock<ShmEvent>);
+    }
+};
+
+// shm_open names start with a slash.
+inline std::string shm_name(const char* name) { return name[0] == '/' ? name : std::string("/") + name; }
+
+} // namespace shm_detail
+
+#if defined(BLOCKHOUSE_WITH_SHM)
+template <size_t Depth = BOOK_DEPTH>
+class ShmSink : public MbpSink {
+    void* base_;
+    size_t size_;
+    ShmHeader* header_;
+    BookSlot<Depth>* books_;
+    Seqlock<ShmEvent>* events_;
+    uint64_t next_ = 0;
+    // Levels as last published per book, to rewrite only what changed.
+    std::vector<std::vector<PriceLevel>> last_;
+
+    ShmSink(void* base, size_t size, const shm_detail::Layout<Depth>& layout, size_t books, size_t events)
+        : base_(base), size_(size), header_(new (base) ShmHeader{}),
+          books_(reinterpret_cast<BookSlot<Depth>*>(static_cast<char*>(base) + layout.books_offset)),
+          events_(reinterpret_cast<Seqlock<ShmEvent>*>(static_cast<char*>(base) + layout.events_offset)) {
+        for (size_t i = 0; i < books; ++i) {
+            new (&books_[i]) BookSlot<Depth>();
+        }
+        for (size_t i = 0; i < events; ++i) {
+            new (&events_[i]) Seqlock<ShmEvent>();
+        }
+        header_->magic = SHM_MAGIC;
+        header_->version = SHM_VERSION;
+        header_->depth = static_cast<uint32_t>(Depth);
+        header_->book_capacity = static_cast<uint32_t>(books);
+        header_->event_capacity = static_cast<uint32_t>(events);
+        header_->books_offset = layout.books_offset;
+        header_->events_offset = layout.events_offset;
+        header_->size = size;
+        header_->state.store(static_cast<uint32_t>(ShmState::Live), std::memory_order_release);
+    }
+
+public:
+    ~ShmSink() override { ::munmap(base_, size_); }
+
+    ShmSink(const ShmSink&) = delete;
+    ShmSink& operator=(const ShmSink&) = delete;
+
+    // Replaces any segment of that name, so readers still attached to an
+    // old one keep it and see it Finished or stalled. events must be a
+    // power of two. Null on failure.
+    static std::unique_ptr<ShmSink> create(const char* name, size_t books = SHM_BOOKS, size_t events = SHM_EVENTS) {
+        if (!books || !events || (events & (events - 1))) {
+            return nullptr;
+        }
+        std::string path = shm_detail::shm_name(name);
+        shm_detail::Layout<Depth> layout(books, events);
+        ::shm_unlink(path.c_str());
+        int fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            return nullptr;
+        }
+        if (::ftruncate(fd, static_cast<off_t>(layout.size)) != 0) {
+            ::close(fd);
+            ::shm_unlink(path.c_str());
+            return nullptr;
+        }
+        void* p = ::mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            ::shm_unlink(path.c_str());
+            return nullptr;
+        }
+        return std::unique_ptr<ShmSink>(new ShmSink(p, layout.size, layout, books, events));
+    }
+
+    void write_row(uint32_t book, const MboMessage& m, LevelsView levels) override {
+        if (book < header_->book_capacity) {
+            if (last_.size() <= book) {
+                last_.resize(book + 1);
+            }
+            auto& last = last_[book];
+            if (last.empty()) {
+                // The slot's first store writes every level.
+                last.assign(levels.data, levels.data + levels.size());
+                if (book >= header_->books.load(std::memory_order_relaxed)) {
+                    header_->books.store(book + 1, std::memory_order_release);
+                }
+            }
+            books_[book].publish(m, 0, levels.data, [&](size_t i) {
+                const PriceLevel& l = levels[i];
+                PriceLevel& p = last[i];
+                if (l.price == p.price && l.size == p.size && l.count == p.count) {
+                    return false;
+                }
+                p = l;
+                return true;
+            });
+        }
+        ShmEvent e{};
+        e.index = next_;
+        e.ts_recv = m.ts_recv;
+        e.ts_event = m.ts_event;
+        e.price = m.price;
+        e.order_id = m.order_id;
+        e.book = book;
+        e.size = m.size;
+        e.sequence = m.sequence;
+        e.ts_in_delta = m.ts_in_delta;
+        e.action = static_cast<char>(m.action);
+        e.side = static_cast<char>(m.side);
+        e.flags = m.flags;
+        events_[next_ & (header_->event_capacity - 1)].store(e);
+        header_->events.store(++next_, std::memory_order_release);
+    }
+
+    bool finish() override {
+        header_->state.store(static_cast<uint32_t>(ShmState::Finished), std::memory_order_release);
+        return true;
+    }
+};
+
+// Attaches read-only to a segment a ShmSink<Depth> writes.
+template <size_t Depth = BOOK_DEPTH>
+class ShmReader {
+    const void* base_;
+    size_t size_;
+    const ShmHeader* header_;
+    const BookSlot<Depth>* books_;
+    const Seqlock<ShmEvent>* events_;
+
+    ShmReader(const void* base, size_t size)
+        : base_(base), size_(size), header_(static_cast<const ShmHeader*>(base)),
+          books_(reinterpret_cast<const BookSlot<Depth>*>(static_cast<const char*>(base) + header_->books_offset)),
+          events_(reinterpret_cast<const Seqlock<ShmEvent>*>(static_cast<const char*>(base) + header_->events_offset)) {}
+
+public:
+    ~ShmReader() { ::munmap(const_cast<void*>(base_), size_); }
+
+    ShmReader(const ShmReader&) = delete;
+    ShmReader& operator=(const ShmReader&) = delete;
+
+    // Null unless name is a live or finished segment of this depth.
+    static std::unique_ptr<ShmReader> open(const char* name) {
+        int fd = ::shm_open(shm_detail::shm_name(name).c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+            ::close(fd);
+            return nullptr;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+        const auto* h = static_cast<const ShmHeader*>(p);
+        auto fail = [&] {
+            ::munmap(p, size);
+            return nullptr;
+        };
+        // The acquire pairs with the writer's release of Live, so the
+        // layout fields are only read once they are filled in.
+        if (h->state.load(std::memory_order_acquire) == static_cast<uint32_t>(ShmState::Starting) ||
+            h->magic != SHM_MAGIC || h->version != SHM_VERSION || h->depth != Depth || h->size != size) {
+            return fail();
+        }
+        shm_detail::Layout<Depth> layout(h->book_capacity, h->event_capacity);
+        if (h->books_offset != layout.books_offset || h->events_offset != layout.events_offset || layout.size != size) {
+            return fail();
+        }
+        return std::unique_ptr<ShmReader>(new ShmReader(p, size));
+    }
+
+    bool finished() const {
+        return header_->state.load(std::memory_order_acquire) == static_cast<uint32_t>(ShmState::Finished);
+    }
+
+    size_t books() const { return header_->books.load(std::memory_order_acquire); }
+
+    const Seqlock<BookSnapshot<Depth>>& book(size_t id) const { return books_[id].snap; }
+
+    // The slot for a book, or null if it has not been published yet.
+    const Seqlock<BookSnapshot<Depth>>* find(uint16_t publisher_id, uint32_t instrument_id) const {
+        uint64_t key = (static_cast<uint64_t>(publisher_id) << 32) | instrument_id;
+        for (size_t i = 0, n = books(); i < n; ++i) {
+            const BookSlot<Depth>& s = books_[i];
+            if (s.snap.version() && s.key.load(std::memory_order_relaxed) == key) {
+                return &s.snap;
+            }
+        }
+        return nullptr;
+    }
+
+    // Events published so far; start a cursor here to follow only new ones.
+    uint64_t events() const { return header_->events.load(std::memory_order_acquire); }
+
+    // The event at cursor, advancing it; false once caught up. A reader
+    // more than a ring behind skips to the oldest event still held and
+    // adds the events it missed to lost.
+    bool next(uint64_t& cursor, ShmEvent& out, uint64_t& lost) const {
+        uint64_t cap = header_->event_capacity;
+        while (true) {
+            uint64_t end = events();
+            if (cursor >= end) {
+                return false;
+            }
+            if (end - cursor > cap) {
+                lost += end - cap - cursor;
+                cursor = end - cap;
+            }
+            out = events_[cursor & (cap - 1)].load();
+            if (out.index == cursor) {
+                ++cursor;
+                return true;
+            }
+            // Overwritten while we looked; catch up and retry.
+        }
+    }
+};
+#endif
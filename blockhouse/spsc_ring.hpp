@@ -0,0 +1,65 @@
+// spsc_ring.hpp
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+// Bounded lock-free single-producer/single-consumer ring. Each side keeps
+// a cached copy of the other's index and only reloads it when the ring
+// looks full or empty, so steady-state traffic touches one shared line
+// per operation.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::atomic<size_t> head_{ 0 };
+    size_t tail_cache_ = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{ 0 };
+    size_t head_cache_ = 0;
+    alignas(CACHE_LINE) T slots_[Capacity];
+
+public:
+    bool try_push(const T& v) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity) {
+                return false;
+            }
+        }
+        slots_[tail & (Capacity - 1)] = v;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        out = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocking forms; they yield rather than spin so oversubscribed boxes
+    // still make progress.
+    void push(const T& v) {
+        while (!try_push(v)) {
+            std::this_thread::yield();
+        }
+    }
+
+    T pop() {
+        T v;
+        while (!try_pop(v)) {
+            std::this_thread::yield();
+        }
+        return v;
+    }
+};
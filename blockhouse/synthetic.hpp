@@ -0,0 +1,271 @@
+// synthetic.hpp
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+#include "timestamp.hpp"
+
+// splitmix64: fast, and unlike the std distributions it yields the same
+// sequence on every platform for a given seed.
+class SplitMix64 {
+    uint64_t s_;
+
+public:
+    explicit SplitMix64(uint64_t seed) : s_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (s_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n).
+    uint64_t below(uint64_t n) { return next() % n; }
+
+    // Uniform in [0, 1).
+    double unit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+struct SyntheticConfig {
+    uint64_t seed = 1;
+    uint16_t publisher_id = 2;
+    // Books get consecutive ids from first_instrument_id and symbols
+    // SYN0, SYN1, ...; each message goes to one of them at random.
+    uint32_t instruments = 1;
+    uint32_t first_instrument_id = 1108;
+    int64_t mid = 5510000000;
+    int64_t tick = 10000000;
+    // New prices sit k ticks behind the touch, k < levels, with
+    // P(k) falling by depth_decay per tick.
+    uint32_t levels = 30;
+    double depth_decay = 0.8;
+    uint32_t max_size = 500;
+    // Per-message probabilities; adds take the rest. A trade is emitted as
+    // trade, fill and cancel of a resting order, and a clear empties the
+    // book with an R message.
+    double cancel = 0.30;
+    double modify = 0.15;
+    double trade = 0.05;
+    double clear = 0.0;
+    // Chance that a modify also moves the order's price.
+    double move = 0.5;
+    uint64_t start_ns = 1752735909000000000ull;
+    // Messages per second across all instruments; gaps are uniform with
+    // this mean.
+    double rate = 1000000;
+};
+
+// Deterministic MBO stream with a realistic add/cancel/modify/trade mix
+// over books that stay populated.
+class SyntheticMbo {
+    struct Resting {
+        uint64_t order_id;
+        int64_t price;
+        uint32_t size;
+        Side side;
+    };
+
+    struct Book {
+        uint32_t instrument_id;
+        FixedString<SYMBOL_LEN> symbol;
+        std::vector<Resting> resting;
+    };
+
+    SyntheticConfig cfg_;
+    SplitMix64 rng_;
+    std::vector<Book> books_;
+    Book* book_ = nullptr;
+    uint64_t next_order_id_ = 1;
+    uint64_t ts_;
+    uint64_t max_gap_ns_;
+    uint32_t sequence_ = 0;
+    MboMessage queue_[3];
+    size_t queued_ = 0;
+    size_t pos_ = 0;
+
+    MboMessage& push(Action action, Side side, int64_t price, uint32_t size, uint64_t order_id) {
+        MboMessage& m = queue_[queued_++];
+        int32_t latency = static_cast<int32_t>(1000 + rng_.below(20000));
+        m.ts_recv = ts_;
+        m.ts_event = ts_ - static_cast<uint64_t>(latency);
+        m.rtype = 0xA0;
+        m.publisher_id = cfg_.publisher_id;
+        m.instrument_id = book_->instrument_id;
+        m.action = action;
+        m.side = side;
+        m.depth = 0;
+        m.price = price;
+        m.size = size;
+        m.flags = 0;
+        m.ts_in_delta = latency;
+        m.sequence = ++sequence_;
+        m.symbol = book_->symbol;
+        m.order_id = order_id;
+        return m;
+    }
+
+    int64_t pick_price(Side side) {
+        uint32_t k = 0;
+        while (k + 1 < cfg_.levels && rng_.unit() < cfg_.depth_decay) {
+            ++k;
+        }
+        int64_t ticks = static_cast<int64_t>(k) * cfg_.tick;
+        return side == Side::B ? cfg_.mid - cfg_.tick - ticks : cfg_.mid + ticks;
+    }
+
+    uint32_t pick_size() { return 1 + static_cast<uint32_t>(rng_.below(cfg_.max_size)); }
+
+    void add() {
+        Side side = rng_.below(2) ? Side::B : Side::A;
+        Resting r{ next_order_id_++, pick_price(side), pick_size(), side };
+        book_->resting.push_back(r);
+        push(Action::A, r.side, r.price, r.size, r.order_id);
+    }
+
+    // Takes size off resting[i], dropping it when nothing is left.
+    void reduce(size_t i, uint32_t size) {
+        auto& resting = book_->resting;
+        resting[i].size -= size;
+        if (resting[i].size == 0) {
+            resting[i] = resting.back();
+            resting.pop_back();
+        }
+    }
+
+    void cancel(size_t i) {
+        Resting r = book_->resting[i];
+        uint32_t size = rng_.below(5) ? r.size : 1 + static_cast<uint32_t>(rng_.below(r.size));
+        push(Action::C, r.side, r.price, size, r.order_id);
+        reduce(i, size);
+    }
+
+    void modify(size_t i) {
+        Resting& r = book_->resting[i];
+        if (rng_.unit() < cfg_.move) {
+            r.price = pick_price(r.side);
+        }
+        r.size = pick_size();
+        push(Action::M, r.side, r.price, r.size, r.order_id);
+    }
+
+    void trade(size_t i) {
+        Resting r = book_->resting[i];
+        uint32_t size = rng_.below(10) < 7 ? r.size : 1 + static_cast<uint32_t>(rng_.below(r.size));
+        Side aggressor = r.side == Side::B ? Side::A : Side::B;
+        push(Action::T, aggressor, r.price, size, 0);
+        push(Action::F, r.side, r.price, size, r.order_id);
+        push(Action::C, r.side, r.price, size, r.order_id);
+        reduce(i, size);
+    }
+
+    void clear() {
+        book_->resting.clear();
+        push(Action::R, Side::N, PRICE_UNDEF, 0, 0);
+    }
+
+    void generate() {
+        queued_ = pos_ = 0;
+        ts_ += rng_.below(max_gap_ns_ + 1);
+        book_ = &books_[rng_.below(books_.size())];
+        auto& resting = book_->resting;
+        double u = rng_.unit();
+        if (u < cfg_.clear) {
+            clear();
+            return;
+        }
+        u -= cfg_.clear;
+        if (resting.empty() || u >= cfg_.cancel + cfg_.modify + cfg_.trade) {
+            add();
+            return;
+        }
+        size_t i = rng_.below(resting.size());
+        if (u < cfg_.cancel) {
+            cancel(i);
+        } else if (u < cfg_.cancel + cfg_.modify) {
+            modify(i);
+        } else {
+            trade(i);
+        }
+    }
+
+public:
+    explicit SyntheticMbo(const SyntheticConfig& cfg = {})
+        : cfg_(cfg), rng_(cfg.seed), ts_(cfg.start_ns),
+          max_gap_ns_(static_cast<uint64_t>(2 * NS_PER_SEC / cfg.rate)) {
+        for (uint32_t i = 0; i < std::max<uint32_t>(cfg_.instruments, 1); ++i) {
+            Book b;
+            b.instrument_id = cfg_.first_instrument_id + i;
+            char name[32] = "SYN";
+            b.symbol.assign(std::string_view(name, static_cast<size_t>(mbp_detail::put_int(name + 3, i) - name)));
+            books_.push_back(std::move(b));
+        }
+    }
+
+    const MboMessage& next() {
+        if (pos_ == queued_) {
+            generate();
+        }
+        return queue_[pos_++];
+    }
+
+    size_t resting() const {
+        size_t n = 0;
+        for (const auto& b : books_) {
+            n += b.resting.size();
+        }
+        return n;
+    }
+};
+
+static constexpr std::string_view MBO_CSV_HEADER =
+    "ts_recv,ts_event,rtype,publisher_id,instrument_id,action,side,depth,price,size,"
+    "order_id,flags,ts_in_delta,sequence,symbol,order_id\n";
+static constexpr size_t MAX_MBO_CSV_LEN = 2 * ISO8601_NS_LEN + SYMBOL_LEN + 160;
+
+// Formats m as one input CSV line (see MboMessage::parse); returns the end.
+inline char* format_mbo_csv(char* q, const MboMessage& m) {
+    using namespace mbp_detail;
+    auto put = [&](std::string_view s) {
+        for (char c : s) {
+            *q++ = c;
+        }
+    };
+    q = format_iso8601(q, m.ts_recv);
+    *q++ = ',';
+    q = format_iso8601(q, m.ts_event);
+    *q++ = ',';
+    q = put_int(q, static_cast<int>(m.rtype));
+    *q++ = ',';
+    q = put_int(q, m.publisher_id);
+    *q++ = ',';
+    q = put_int(q, m.instrument_id);
+    *q++ = ',';
+    *q++ = static_cast<char>(m.action);
+    *q++ = ',';
+    *q++ = static_cast<char>(m.side);
+    *q++ = ',';
+    q = put_int(q, m.depth);
+    *q++ = ',';
+    q = put_price(q, m.price);
+    *q++ = ',';
+    q = put_int(q, m.size);
+    *q++ = ',';
+    q = put_int(q, m.order_id);
+    *q++ = ',';
+    q = put_int(q, static_cast<int>(m.flags));
+    *q++ = ',';
+    q = put_int(q, m.ts_in_delta);
+    *q++ = ',';
+    q = put_int(q, m.sequence);
+    *q++ = ',';
+    put(m.symbol.view());
+    *q++ = ',';
+    q = put_int(q, m.order_id);
+    *q++ = '\n';
+    return q;
+}
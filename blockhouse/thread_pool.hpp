@@ -0,0 +1,97 @@
+// thread_pool.hpp
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a fixed list of jobs on a set of threads. Jobs are dealt out
+// round-robin to per-worker deques; a worker takes from the front of its
+// own and, once that is empty, steals from the back of the others', so a
+// few long jobs never leave the rest of their queue waiting.
+class WorkStealingPool {
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    bool take(size_t self, size_t& job) {
+        for (size_t k = 0; k < queues_.size(); ++k) {
+            Queue& q = *queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.jobs.empty()) {
+                continue;
+            }
+            if (k == 0) {
+                job = q.jobs.front();
+                q.jobs.pop_front();
+            } else {
+                job = q.jobs.back();
+                q.jobs.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(size_t workers) {
+        for (size_t i = 0; i < (workers ? workers : 1); ++i) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+    }
+
+    size_t workers() const { return queues_.size(); }
+
+    // Calls fn(worker, job) for every job in [0, jobs), worker being the
+    // calling thread's index in [0, workers()), and returns once all are
+    // done. Earlier jobs start first.
+    template <typename F>
+    void run(size_t jobs, F&& fn) {
+        for (size_t j = 0; j < jobs; ++j) {
+            queues_[j % queues_.size()]->jobs.push_back(j);
+        }
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < queues_.size(); ++w) {
+            threads.emplace_back([this, &fn, w] {
+                size_t job;
+                while (take(w, job)) {
+                    fn(w, job);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+};
+
+// Counting semaphore, usable with std::lock_guard, that caps how many
+// threads hold a resource at once.
+class IoSlots {
+    std::mutex lock_;
+    std::condition_variable freed_;
+    size_t free_;
+
+public:
+    explicit IoSlots(size_t slots) : free_(slots ? slots : 1) {}
+
+    void lock() {
+        std::unique_lock<std::mutex> guard(lock_);
+        freed_.wait(guard, [this] { return free_ > 0; });
+        --free_;
+    }
+
+    void unlock() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            ++free_;
+        }
+        freed_.notify_one();
+    }
+};
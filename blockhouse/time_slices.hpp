@@ -0,0 +1,189 @@
+// time_slices.hpp
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "book_manager.hpp"
+#include "checkpoint.hpp"
+#include "feed_stats.hpp"
+#include "input_source.hpp"
+#include "instrument.hpp"
+#include "mbo.hpp"
+#include "mbp_writer.hpp"
+
+// Reconstructs CSV text held in memory as consecutive time slices on
+// parallel threads. A first pass applies every message without
+// formatting and snapshots the books into an in-memory checkpoint at each
+// slice boundary. As soon as a slice's end is known a worker restores its
+// starting snapshot and formats the slice, the first one straight to the
+// output and the rest into temporary files. run() finally appends those
+// in order. The bytes match a single-threaded run.
+template <size_t Depth = BOOK_DEPTH>
+class TimeSlicedReconstruction {
+    static constexpr size_t COPY_BLOCK = 1 << 20;
+
+    struct Slice {
+        std::vector<char> image;
+        std::string_view text;
+        std::FILE* spill = nullptr;
+        bool ok = false;
+        std::thread worker;
+    };
+
+    std::string_view text_;
+    size_t slices_;
+    size_t first_book_orders_;
+    bool changed_only_;
+    int fd_;
+    const PricePrecision* prices_;
+    BookManager<Depth> books_;
+    uint64_t bad_lines_ = 0;
+    std::vector<std::unique_ptr<Slice>> work_;
+
+    void reconstruct(Slice& s, int fd) {
+        BookManager<Depth> books(first_book_orders_);
+        CheckpointHeader h;
+        if (!s.image.empty() && !restore_checkpoint(s.image.data(), s.image.size(), books, h)) {
+            return;
+        }
+        s.image = {};
+        OutputBuffer out(fd);
+        MbpWriterSet writers(out, prices_);
+        auto emit = [&](const auto& e, const MboMessage& m) {
+            if (!changed_only_ || e.book.changes().any()) {
+                instrument::Timer timer(instrument::WRITE);
+                writers[e.id].write_row(m, e.book.levels());
+            }
+        };
+        for_each_line(s.text, [&](std::string_view line) {
+            std::optional<MboMessage> m;
+            {
+                instrument::Timer timer(instrument::PARSE);
+                m = MboMessage::parse(line);
+            }
+            if (m) {
+                books.process(*m, emit);
+            }
+        });
+        books.finish(emit);
+        s.ok = out.flush();
+    }
+
+    // Hands [begin, end) to a new worker, starting from the books' state
+    // in image.
+    void start(std::vector<char> image, size_t begin, size_t end) {
+        auto s = std::make_unique<Slice>();
+        s->image = std::move(image);
+        s->text = text_.substr(begin, end - begin);
+        int fd = fd_;
+        if (!work_.empty()) {
+            s->spill = std::tmpfile();
+            if (!s->spill) {
+                work_.push_back(std::move(s));
+                return;
+            }
+#if defined(_WIN32)
+            fd = _fileno(s->spill);
+#else
+            fd = fileno(s->spill);
+#endif
+        }
+        Slice* p = s.get();
+        s->worker = std::thread([this, p, fd] { reconstruct(*p, fd); });
+        work_.push_back(std::move(s));
+    }
+
+    static bool append(std::FILE* f, OutputBuffer& out) {
+        std::rewind(f);
+        while (true) {
+            char* p = out.reserve(COPY_BLOCK);
+            size_t n = std::fread(p, 1, COPY_BLOCK, f);
+            if (n == 0) {
+                return !std::ferror(f);
+            }
+            out.commit(p + n);
+        }
+    }
+
+public:
+    TimeSlicedReconstruction(std::string_view text, size_t slices, size_t first_book_orders,
+                             bool changed_only = false, int fd = 1, const PricePrecision* prices = nullptr)
+        : text_(text), slices_(slices ? slices : 1), first_book_orders_(first_book_orders),
+          changed_only_(changed_only), fd_(fd), prices_(prices), books_(first_book_orders) {}
+
+    ~TimeSlicedReconstruction() {
+        for (auto& s : work_) {
+            if (s->worker.joinable()) {
+                s->worker.join();
+            }
+            if (s->spill) {
+                std::fclose(s->spill);
+            }
+        }
+    }
+
+    TimeSlicedReconstruction(const TimeSlicedReconstruction&) = delete;
+    TimeSlicedReconstruction& operator=(const TimeSlicedReconstruction&) = delete;
+
+    // False if a slice failed to restore, spill or write.
+    bool run() {
+        auto no_rows = [](const auto&, const MboMessage&) {};
+        std::vector<char> image;
+        size_t begin = 0;
+        size_t pos = 0;
+        uint64_t messages = 0;
+        uint32_t sequence = 0;
+        // Slices split the bytes evenly, each ending at the first message
+        // past its share that leaves no trade pending.
+        auto boundary = [&] { return (work_.size() + 1) * (text_.size() / slices_); };
+        for_each_line(text_, [&](std::string_view line) {
+            pos += line.size() + 1;
+            std::optional<MboMessage> m = MboMessage::parse(line);
+            if (!m) {
+                bad_lines_ += !is_csv_header(line);
+                return;
+            }
+            books_.process(*m, no_rows);
+            ++messages;
+            sequence = m->sequence;
+            if (work_.size() + 1 < slices_ && pos >= boundary() && pos < text_.size() && books_.idle()) {
+                std::vector<char> next;
+                write_checkpoint(books_, CheckpointHeader{ {}, pos, messages, sequence, 0, bad_lines_ },
+                                 [&](const void* p, size_t n) {
+                                     next.insert(next.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+                                 });
+                start(std::move(image), begin, pos);
+                image = std::move(next);
+                begin = pos;
+            }
+        });
+        books_.finish(no_rows);
+        start(std::move(image), begin, text_.size());
+
+        bool ok = true;
+        OutputBuffer out(fd_);
+        for (auto& s : work_) {
+            if (s->worker.joinable()) {
+                s->worker.join();
+            }
+            ok = ok && s->ok;
+            if (ok && s->spill) {
+                ok = append(s->spill, out);
+            }
+        }
+        return out.flush() && ok;
+    }
+
+    size_t slices() const { return work_.size(); }
+
+    // The first pass's books, which end in the final state.
+    const BookManager<Depth>& books() const { return books_; }
+
+    // Lines the first pass could not parse.
+    uint64_t bad_lines() const { return bad_lines_; }
+};
@@ -0,0 +1,271 @@
+// timestamp.hpp
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+static constexpr uint64_t NS_PER_SEC = 1000000000ull;
+static constexpr uint64_t SECS_PER_DAY = 86400;
+// "YYYY-MM-DDTHH:MM:SS.nnnnnnnnnZ"
+static constexpr size_t ISO8601_NS_LEN = 30;
+
+namespace ts_detail {
+
+inline void put2(char* out, unsigned v) {
+    out[0] = static_cast<char>('0' + v / 10);
+    out[1] = static_cast<char>('0' + v % 10);
+}
+
+// Days since 1970-01-01 to a proleptic Gregorian date (H. Hinnant's
+// civil_from_days).
+inline void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+inline int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+// A real calendar date no earlier than the epoch, and a time of day
+// without leap seconds.
+inline bool valid_date(int64_t y, unsigned m, unsigned d) {
+    static constexpr unsigned DAYS[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (y < 1970 || m < 1 || m > 12 || d < 1 || d > DAYS[m - 1]) {
+        return false;
+    }
+    return m != 2 || d < 29 || (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0));
+}
+
+inline bool valid_time(unsigned h, unsigned mi, unsigned s) { return h < 24 && mi < 60 && s < 60; }
+
+// secs and frac as nanoseconds; false past 2554-07-21T23:34:33.709551615Z,
+// the last instant a uint64_t holds.
+inline bool to_ns(uint64_t secs, uint64_t frac, uint64_t& ns) {
+    static constexpr uint64_t MAX = ~0ull;
+    static constexpr uint64_t MAX_SECS = MAX / NS_PER_SEC;
+    if (secs >= MAX_SECS && (secs > MAX_SECS || frac > MAX % NS_PER_SEC)) {
+        return false;
+    }
+    ns = secs * NS_PER_SEC + frac;
+    return true;
+}
+
+inline bool digits(const char* p, size_t n, unsigned& v) {
+    v = 0;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned d = static_cast<unsigned char>(p[i]) - '0';
+        if (d > 9) {
+            return false;
+        }
+        v = v * 10 + d;
+    }
+    return true;
+}
+
+// The exact ISO8601_NS_LEN layout, read as four 64-bit words. Separators
+// are checked against a template and zeroed; every other byte must be a
+// digit. Adjacent digits are then paired within each word in one
+// multiply, leaving two-digit values at known byte offsets.
+inline bool parse_iso8601_fixed(const char* p, uint64_t& ns) {
+    static constexpr char LAYOUT[] = "0000-00-00T00:00:00.000000000Z";
+    static constexpr uint64_t ZEROS = 0x3030303030303030ull;
+    // "YYYY-MM-", "DDTHH:MM", ":SS.nnnn", then "nnnnnnnZ" overlapping.
+    static constexpr size_t OFFSETS[4] = { 0, 8, 16, 22 };
+    struct Word {
+        uint64_t layout = 0;
+        uint64_t sep = 0;
+    };
+    static constexpr auto WORDS = [] {
+        std::array<Word, 4> a{};
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t b = 0; b < 8; ++b) {
+                uint64_t c = static_cast<unsigned char>(LAYOUT[OFFSETS[i] + b]);
+                a[i].layout |= c << (8 * b);
+                if (c != '0') {
+                    a[i].sep |= 0xFFull << (8 * b);
+                }
+            }
+        }
+        return a;
+    }();
+    uint64_t d[4], pairs[4];
+    for (size_t i = 0; i < 4; ++i) {
+        uint64_t w;
+        std::memcpy(&w, p + OFFSETS[i], 8);
+        if ((w & WORDS[i].sep) != (WORDS[i].layout & WORDS[i].sep)) {
+            return false;
+        }
+        w = (w & ~WORDS[i].sep) | (ZEROS & WORDS[i].sep);
+        if ((w & 0xF0F0F0F0F0F0F0F0ull) != ZEROS || ((w + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) != ZEROS) {
+            return false;
+        }
+        d[i] = w - ZEROS;
+        pairs[i] = d[i] * 10 + (d[i] >> 8);
+    }
+    auto at = [&](size_t word, int byte) { return static_cast<unsigned>(pairs[word] >> (8 * byte) & 0xFF); };
+    // The date changes rarely, and converting it costs more than the rest.
+    struct Day {
+        uint64_t date = ~0ull;
+        int64_t days = 0;
+    };
+    thread_local Day last;
+    uint64_t date = d[0] << 8 | at(1, 0);
+    if (date != last.date) {
+        int64_t y = at(0, 0) * 100 + at(0, 2);
+        if (!valid_date(y, at(0, 5), at(1, 0))) {
+            return false;
+        }
+        last = { date, days_from_civil(y, at(0, 5), at(1, 0)) };
+    }
+    if (!valid_time(at(1, 3), at(1, 6), at(2, 1))) {
+        return false;
+    }
+    uint64_t frac = (at(2, 4) * 100 + at(2, 6)) * 100000ull + at(3, 2) * 1000u + at(3, 4) * 10u +
+        static_cast<unsigned>(d[3] >> 48 & 0xFF);
+    uint64_t secs = static_cast<uint64_t>(last.days) * SECS_PER_DAY + at(1, 3) * 3600u + at(1, 6) * 60u + at(2, 1);
+    return to_ns(secs, frac, ns);
+}
+
+} // namespace ts_detail
+
+// Accepts ISO-8601 UTC ("2025-07-17T07:05:09.035793433Z", with 0-9
+// fractional digits and the Z optional) or integer nanoseconds since the
+// epoch. Dates before 1970 or past 2554-07-21T23:34:33.709551615Z, the
+// range of uint64_t nanoseconds, and out-of-range fields are rejected.
+inline bool parse_timestamp(std::string_view s, uint64_t& ns) {
+    using namespace ts_detail;
+    if (s.size() == ISO8601_NS_LEN && parse_iso8601_fixed(s.data(), ns)) {
+        return true;
+    }
+    if (s.size() < 19 || s[4] != '-') {
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), ns);
+        return ec == std::errc() && ptr == s.data() + s.size() && !s.empty();
+    }
+    const char* p = s.data();
+    unsigned y, mo, d, h, mi, sec;
+    if (!digits(p, 4, y) || !digits(p + 5, 2, mo) || !digits(p + 8, 2, d) || p[7] != '-' ||
+        (p[10] != 'T' && p[10] != ' ') || !digits(p + 11, 2, h) || p[13] != ':' ||
+        !digits(p + 14, 2, mi) || p[16] != ':' || !digits(p + 17, 2, sec) || !valid_date(y, mo, d) ||
+        !valid_time(h, mi, sec)) {
+        return false;
+    }
+    size_t i = 19;
+    uint64_t frac = 0;
+    size_t nd = 0;
+    if (i < s.size() && s[i] == '.') {
+        for (++i; i < s.size() && nd < 9; ++i, ++nd) {
+            unsigned dg = static_cast<unsigned char>(s[i]) - '0';
+            if (dg > 9) {
+                break;
+            }
+            frac = frac * 10 + dg;
+        }
+    }
+    for (; nd < 9; ++nd) {
+        frac *= 10;
+    }
+    if (i != s.size() && !(i + 1 == s.size() && s[i] == 'Z')) {
+        return false;
+    }
+    int64_t days = days_from_civil(y, mo, d);
+    uint64_t secs = static_cast<uint64_t>(days) * SECS_PER_DAY + h * 3600u + mi * 60u + sec;
+    return to_ns(secs, frac, ns);
+}
+
+// Writes nanoseconds since the UNIX epoch as ISO-8601 UTC with nanosecond
+// precision; returns the end of the ISO8601_NS_LEN bytes written.
+inline char* format_iso8601(char* out, uint64_t ns) {
+    using namespace ts_detail;
+    uint64_t secs = ns / NS_PER_SEC;
+    uint64_t frac = ns % NS_PER_SEC;
+    int64_t y;
+    unsigned mo, d;
+    civil_from_days(static_cast<int64_t>(secs / SECS_PER_DAY), y, mo, d);
+    unsigned sod = static_cast<unsigned>(secs % SECS_PER_DAY);
+    put2(out, static_cast<unsigned>(y / 100));
+    put2(out + 2, static_cast<unsigned>(y % 100));
+    out[4] = '-';
+    put2(out + 5, mo);
+    out[7] = '-';
+    put2(out + 8, d);
+    out[10] = 'T';
+    put2(out + 11, sod / 3600);
+    out[13] = ':';
+    put2(out + 14, sod / 60 % 60);
+    out[16] = ':';
+    put2(out + 17, sod % 60);
+    out[19] = '.';
+    for (int i = 28; i >= 20; --i) {
+        out[i] = static_cast<char>('0' + frac % 10);
+        frac /= 10;
+    }
+    out[29] = 'Z';
+    return out + ISO8601_NS_LEN;
+}
+
+// format_iso8601 for a run of stamps that mostly fall on the same UTC day:
+// the "YYYY-MM-DDT" prefix is kept from the previous call, so usually only
+// the time of day is formatted, two digits at a time.
+class Iso8601Writer {
+    static constexpr size_t DATE_LEN = 11;
+
+    static constexpr auto PAIRS = [] {
+        std::array<char, 200> a{};
+        for (size_t i = 0; i < 100; ++i) {
+            a[2 * i] = static_cast<char>('0' + i / 10);
+            a[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+        return a;
+    }();
+
+    uint64_t day_ = ~0ull;
+    char date_[ISO8601_NS_LEN];
+
+    static char* put2(char* out, uint64_t v) {
+        std::memcpy(out, &PAIRS[2 * v], 2);
+        return out + 2;
+    }
+
+public:
+    char* write(char* out, uint64_t ns) {
+        uint64_t secs = ns / NS_PER_SEC;
+        uint64_t day = secs / SECS_PER_DAY;
+        if (day != day_) {
+            format_iso8601(date_, ns);
+            day_ = day;
+        }
+        std::memcpy(out, date_, DATE_LEN);
+        uint64_t sod = secs - day * SECS_PER_DAY;
+        uint64_t frac = ns - secs * NS_PER_SEC;
+        char* q = put2(out + DATE_LEN, sod / 3600);
+        *q++ = ':';
+        q = put2(q, sod / 60 % 60);
+        *q++ = ':';
+        q = put2(q, sod % 60);
+        *q++ = '.';
+        *q++ = static_cast<char>('0' + frac / 100000000);
+        uint64_t rest = frac % 100000000;
+        q = put2(q, rest / 1000000);
+        q = put2(q, rest / 10000 % 100);
+        q = put2(q, rest / 100 % 100);
+        q = put2(q, rest % 100);
+        *q++ = 'Z';
+        return q;
+    }
+};
@@ -0,0 +1,159 @@
+// verify_sink.hpp
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include "feed_stats.hpp"
+#include "input_source.hpp"
+#include "mbp_sink.hpp"
+#include "mbp_writer.hpp"
+#include "price_format.hpp"
+
+// Checks the CSV rows a run would write against a reference MBP file
+// instead of writing them. Rows are formatted into memory and compared a
+// batch at a time: runs that match the reference byte for byte, the
+// usual case, cost one memcmp each, and only a differing row is taken
+// apart. The reference may start with a header line and may end its
+// lines with \r\n.
+class VerifySink : public MbpSink {
+    static constexpr size_t BATCH_BYTES = 1 << 20;
+    // Differing rows named on stderr; the rest are only counted.
+    static constexpr uint64_t MAX_REPORTED = 5;
+
+    OutputBuffer out_{ OutputBuffer::IN_MEMORY };
+    MbpWriterSet writers_;
+    std::unique_ptr<InputSource> ref_;
+    // Unchecked part of the reference's current chunk.
+    std::string_view pending_;
+    // Rows written before the batch being checked.
+    uint64_t rows_before_ = 0;
+    uint64_t rows_ = 0;
+    uint64_t differ_ = 0;
+    uint64_t missing_ = 0;
+    uint64_t extra_ = 0;
+
+    bool refill() {
+        while (pending_.empty()) {
+            if (!ref_->next_chunk(pending_)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::string_view take_line(std::string_view& text) {
+        size_t nl = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(std::min(nl + 1, text.size()));
+        return line;
+    }
+
+    // The next reference row, less any header and \r; false at the end.
+    bool next_ref(std::string_view& line) {
+        while (refill()) {
+            line = take_line(pending_);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!is_csv_header(line)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void report(uint64_t row, std::string_view got, std::string_view want) {
+        if (++differ_ > MAX_REPORTED) {
+            return;
+        }
+        size_t at = static_cast<size_t>(std::mismatch(got.begin(), got.end(), want.begin(), want.end()).first - got.begin());
+        size_t column = static_cast<size_t>(std::count(got.begin(), got.begin() + at, ',')) + 1;
+        size_t comma = at ? got.rfind(',', at - 1) : std::string_view::npos;
+        size_t begin = comma == std::string_view::npos ? 0 : comma + 1;
+        auto field = [begin](std::string_view s) {
+            s = s.substr(std::min(begin, s.size()));
+            return s.substr(0, s.find(','));
+        };
+        std::string_view g = field(got), w = field(want);
+        std::fprintf(stderr, "verify: row %llu column %zu: got \"%.*s\", want \"%.*s\"\n",
+                     static_cast<unsigned long long>(row), column, static_cast<int>(g.size()), g.data(),
+                     static_cast<int>(w.size()), w.data());
+    }
+
+    // Compares whole rows written since the last check.
+    void check() {
+        std::string_view rest = out_.contents();
+        // Rows before counted, for naming a differing one.
+        uint64_t row = rows_before_;
+        const char* counted = rest.data();
+        while (!rest.empty()) {
+            if (!refill()) {
+                missing_ += static_cast<uint64_t>(std::count(rest.begin(), rest.end(), '\n'));
+                break;
+            }
+            // Both sides end the compared run at a row boundary.
+            size_t n = std::min(rest.size(), pending_.size());
+            if (rest[n - 1] == '\n' && pending_[n - 1] == '\n' && std::memcmp(rest.data(), pending_.data(), n) == 0) {
+                rest.remove_prefix(n);
+                pending_.remove_prefix(n);
+                continue;
+            }
+            // Skip the rows ahead of the first differing byte, then compare
+            // that row on its own.
+            size_t at = static_cast<size_t>(std::mismatch(rest.begin(), rest.begin() + n, pending_.begin()).first - rest.begin());
+            size_t same = rest.substr(0, at).rfind('\n');
+            same = same == std::string_view::npos ? 0 : same + 1;
+            rest.remove_prefix(same);
+            pending_.remove_prefix(same);
+            row += static_cast<uint64_t>(std::count(counted, rest.data(), '\n'));
+            std::string_view got = take_line(rest);
+            counted = rest.data();
+            ++row;
+            std::string_view want;
+            if (!next_ref(want)) {
+                missing_ += 1 + static_cast<uint64_t>(std::count(rest.begin(), rest.end(), '\n'));
+                break;
+            }
+            if (got != want) {
+                report(row, got, want);
+            }
+        }
+        rows_before_ = rows_;
+        out_.clear();
+    }
+
+public:
+    VerifySink(std::unique_ptr<InputSource> ref, const PricePrecision* precision = nullptr)
+        : writers_(out_, precision), ref_(std::move(ref)) {}
+
+    void write_row(uint32_t book, const MboMessage& m, LevelsView levels) override {
+        writers_[book].write_row(m, levels);
+        ++rows_;
+        if (out_.contents().size() >= BATCH_BYTES) {
+            check();
+        }
+    }
+
+    bool flush() override {
+        check();
+        return true;
+    }
+
+    // Checks the rest and prints a summary; false unless every row
+    // matched and the reference has none left over.
+    bool finish() override {
+        check();
+        std::string_view line;
+        while (next_ref(line)) {
+            ++extra_;
+        }
+        std::fprintf(stderr, "verify: %llu rows, %llu differ, %llu past the end of the reference, %llu only in the reference\n",
+                     static_cast<unsigned long long>(rows_), static_cast<unsigned long long>(differ_),
+                     static_cast<unsigned long long>(missing_), static_cast<unsigned long long>(extra_));
+        return differ_ == 0 && missing_ == 0 && extra_ == 0;
+    }
+};